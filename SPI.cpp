@@ -12,6 +12,7 @@
  */
 
 #include "SPI.h"
+#if !defined(ARDUINO_ARCH_HOST)
 
 SPIClass SPI;
 
@@ -191,3 +192,4 @@ void SPIClass::notUsingInterrupt(uint8_t interruptNumber)
     interruptMode = 0;
   SREG = sreg;
 }
+#endif  // ARDUINO_ARCH_HOST
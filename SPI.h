@@ -14,6 +14,21 @@
 #ifndef _SPI_H_INCLUDED
 #define _SPI_H_INCLUDED
 
+// Uncomment this line to record, for each SPISettings, the transactions, the
+// bytes moved by transfer(), the time the bus is held and the time the
+// interrupts given to usingInterrupt() are masked.  SPIProfile::report()
+// prints them.  It costs a few cycles per byte and two micros() calls per
+// transaction.
+//#define SPI_PROFILE
+
+#ifdef SPI_PROFILE
+#include "SPIProfile.h"
+#endif
+
+#if defined(ARDUINO_ARCH_HOST)
+// Simulated bus for running the library on a PC, see extras/host.
+#include <HostSPI.h>
+#else  // ARDUINO_ARCH_HOST
 #include <Arduino.h>
 
 // SPI_HAS_TRANSACTION means SPI has beginTransaction(), endTransaction(),
@@ -30,6 +45,9 @@
 // available too.
 #define SPI_ATOMIC_VERSION 1
 
+// SPI_HAS_BLOCK_TRANSFER means SPI has transfer(txbuf, rxbuf, count)
+#define SPI_HAS_BLOCK_TRANSFER 1
+
 // Uncomment this line to add detection of mismatched begin/end transactions.
 // A mismatch occurs if other libraries fail to use SPI.endTransaction() for
 // each SPI.beginTransaction().  Connect an LED to this pin.  The LED will turn
@@ -200,12 +218,19 @@ public:
     inTransactionFlag = 1;
     #endif
 
+    #ifdef SPI_PROFILE
+    SPIProfile::begin(settings.spcr << 8 | settings.spsr, interruptMode > 0);
+    #endif
+
     SPCR = settings.spcr;
     SPSR = settings.spsr;
   }
 
   // Write to the SPI bus (MOSI pin) and also receive (MISO pin)
   inline static uint8_t transfer(uint8_t data) {
+    #ifdef SPI_PROFILE
+    SPIProfile::count(1);
+    #endif
     SPDR = data;
     /*
      * The following NOP introduces a small delay that can prevent the wait
@@ -220,6 +245,9 @@ public:
   inline static uint16_t transfer16(uint16_t data) {
     union { uint16_t val; struct { uint8_t lsb; uint8_t msb; }; } in, out;
     in.val = data;
+    #ifdef SPI_PROFILE
+    SPIProfile::count(2);
+    #endif
     if (!(SPCR & _BV(DORD))) {
       SPDR = in.msb;
       asm volatile("nop"); // See transfer(uint8_t) function
@@ -243,6 +271,9 @@ public:
   }
   inline static void transfer(void *buf, size_t count) {
     if (count == 0) return;
+    #ifdef SPI_PROFILE
+    SPIProfile::count(count);
+    #endif
     uint8_t *p = (uint8_t *)buf;
     SPDR = *p;
     while (--count > 0) {
@@ -255,9 +286,65 @@ public:
     while (!(SPSR & _BV(SPIF))) ;
     *p = SPDR;
   }
+  // Send count bytes from txbuf and store the bytes received in rxbuf.
+  // With txbuf NULL 0xFF is sent, with rxbuf NULL what comes in is dropped.
+  // Each loop fetches the next byte while the current one shifts out, so
+  // the bytes follow each other with no gap down to SPI_CLOCK_DIV4 and
+  // the loop itself costs nothing.
+  inline static void transfer(const void *txbuf, void *rxbuf, size_t count) {
+    if (count == 0) return;
+    #ifdef SPI_PROFILE
+    SPIProfile::count(count);
+    #endif
+    const uint8_t *tx = (const uint8_t *)txbuf;
+    uint8_t *rx = (uint8_t *)rxbuf;
+    if (!rx && !tx) {
+      // Only clocks, like the idle bytes a card waits for
+      SPDR = 0xFF;
+      while (--count > 0) {
+        while (!(SPSR & _BV(SPIF))) ;
+        SPDR = 0xFF;
+      }
+      while (!(SPSR & _BV(SPIF))) ;
+    } else if (!rx) {
+      // SPIF is cleared by the write to SPDR, no need to read it
+      SPDR = *tx++;
+      while (--count > 0) {
+        uint8_t out = *tx++;
+        while (!(SPSR & _BV(SPIF))) ;
+        SPDR = out;
+      }
+      while (!(SPSR & _BV(SPIF))) ;
+    } else if (!tx) {
+      SPDR = 0xFF;
+      while (--count > 0) {
+        while (!(SPSR & _BV(SPIF))) ;
+        uint8_t in = SPDR;
+        SPDR = 0xFF;
+        *rx++ = in;
+      }
+      while (!(SPSR & _BV(SPIF))) ;
+      *rx = SPDR;
+    } else {
+      SPDR = *tx++;
+      while (--count > 0) {
+        uint8_t out = *tx++;
+        while (!(SPSR & _BV(SPIF))) ;
+        uint8_t in = SPDR;
+        SPDR = out;
+        *rx++ = in;
+      }
+      while (!(SPSR & _BV(SPIF))) ;
+      *rx = SPDR;
+    }
+  }
   // After performing a group of transfers and releasing the chip select
   // signal, this function allows others to access the SPI bus
   inline static void endTransaction(void) {
+    #ifdef SPI_PROFILE
+    SPIProfile::end();
+    #endif
+
     #ifdef SPI_TRANSACTION_MISMATCH_LED
     if (!inTransactionFlag) {
       pinMode(SPI_TRANSACTION_MISMATCH_LED, OUTPUT);
@@ -321,4 +408,5 @@ private:
 
 extern SPIClass SPI;
 
+#endif  // ARDUINO_ARCH_HOST
 #endif
@@ -0,0 +1,104 @@
+/*
+ * SPI transaction profiler for the SPI library, enabled by SPI_PROFILE.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#include "SPI.h"
+#ifdef SPI_PROFILE
+
+SPIProfile::Slot SPIProfile::slots[SPI_PROFILE_SLOTS];
+uint32_t SPIProfile::bytesOutside = 0;
+uint16_t SPIProfile::nested = 0;
+uint16_t SPIProfile::unmatched = 0;
+uint16_t SPIProfile::dropped = 0;
+SPIProfile::Slot *SPIProfile::current = 0;
+uint8_t SPIProfile::depth = 0;
+bool SPIProfile::masked = false;
+uint32_t SPIProfile::start = 0;
+
+void SPIProfile::begin(uint16_t settings, bool isMasked)
+{
+  if (depth++) {
+    // The outer transaction goes on, with the new settings
+    nested++;
+    return;
+  }
+  current = 0;
+  for (uint8_t i = 0; i < SPI_PROFILE_SLOTS; i++) {
+    Slot *s = &slots[i];
+    if (s->transactions == 0) s->settings = settings;
+    if (s->settings == settings) {
+      current = s;
+      break;
+    }
+  }
+  if (!current) {
+    dropped++;
+    return;
+  }
+  current->transactions++;
+  masked = isMasked;
+  start = micros();
+}
+
+void SPIProfile::end()
+{
+  if (depth == 0) {
+    unmatched++;
+    return;
+  }
+  if (--depth || !current) return;
+  uint32_t t = micros() - start;
+  current->heldMicros += t;
+  if (masked) {
+    current->maskedMicros += t;
+    if (t > current->maxMaskedMicros) current->maxMaskedMicros = t;
+  }
+  current = 0;
+}
+
+void SPIProfile::reset()
+{
+  memset(slots, 0, sizeof(slots));
+  bytesOutside = 0;
+  nested = 0;
+  unmatched = 0;
+  dropped = 0;
+  current = 0;
+  depth = 0;
+}
+
+void SPIProfile::report(Print &out)
+{
+  for (uint8_t i = 0; i < SPI_PROFILE_SLOTS && slots[i].transactions; i++) {
+    Slot *s = &slots[i];
+    out.print(F("SPI settings 0x"));
+    out.print(s->settings, HEX);
+    out.print(F(": "));
+    out.print(s->transactions);
+    out.print(F(" transactions, "));
+    out.print(s->bytes);
+    out.print(F(" bytes, held "));
+    out.print(s->heldMicros);
+    out.print(F(" us, masked "));
+    out.print(s->maskedMicros);
+    out.print(F(" us, longest masked "));
+    out.print(s->maxMaskedMicros);
+    out.println(F(" us"));
+  }
+  out.print(F("SPI outside transactions: "));
+  out.print(bytesOutside);
+  out.println(F(" bytes"));
+  out.print(F("SPI nested "));
+  out.print(nested);
+  out.print(F(", unmatched "));
+  out.print(unmatched);
+  out.print(F(", not recorded "));
+  out.println(dropped);
+}
+
+#endif
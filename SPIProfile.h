@@ -0,0 +1,64 @@
+/*
+ * SPI transaction profiler for the SPI library, enabled by SPI_PROFILE.
+ *
+ * For each SPISettings used with beginTransaction(), it counts the
+ * transactions, the bytes moved by SPI.transfer(), the time the bus was
+ * held and the time interrupts registered with usingInterrupt() were
+ * masked, with the longest of these. Nested and unmatched transactions
+ * are counted too.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of either the GNU General Public License version 2
+ * or the GNU Lesser General Public License version 2.1, both as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _SPI_PROFILE_H_INCLUDED
+#define _SPI_PROFILE_H_INCLUDED
+
+#include <Arduino.h>
+#include <Print.h>
+
+// Number of different SPISettings recorded, the next ones are not.
+#ifndef SPI_PROFILE_SLOTS
+#define SPI_PROFILE_SLOTS 4
+#endif
+
+class SPIProfile {
+public:
+  struct Slot {
+    uint16_t settings;        // SPISettings, as packed by SPIClass
+    uint32_t transactions;
+    uint32_t bytes;
+    uint32_t heldMicros;      // time between begin and end
+    uint32_t maskedMicros;    // part of it with interrupts masked
+    uint32_t maxMaskedMicros; // longest masked transaction
+  };
+
+  // Called by SPIClass
+  static void begin(uint16_t settings, bool masked);
+  static void end();
+  static void count(uint16_t n) {
+    if (current) current->bytes += n;
+    else bytesOutside += n;
+  }
+
+  // Clear everything, must not be called inside a transaction
+  static void reset();
+  // Print one line per SPISettings, then the other counts
+  static void report(Print &out);
+
+  static Slot slots[SPI_PROFILE_SLOTS];
+  static uint32_t bytesOutside;   // bytes moved outside transactions
+  static uint16_t nested;         // beginTransaction() inside a transaction
+  static uint16_t unmatched;      // endTransaction() outside a transaction
+  static uint16_t dropped;        // transactions with no free slot
+
+private:
+  static Slot *current;
+  static uint8_t depth;
+  static bool masked;
+  static uint32_t start;
+};
+
+#endif
@@ -244,12 +244,27 @@ class SdFatBase : public FatFileSystem {
   bool writeBlock(uint32_t block, const uint8_t* src) {
     return m_sdCard.writeBlock(block, src);
   }
+  bool readStream(uint32_t block, uint8_t* dst, size_t n) {
+    return m_sdCard.readStream(block, dst, n);
+  }
+  bool readStreamStop() {
+    return m_sdCard.readStreamStop();
+  }
   bool readBlocks(uint32_t block, uint8_t* dst, size_t n) {
     return m_sdCard.readBlocks(block, dst, n);
   }
   bool writeBlocks(uint32_t block, const uint8_t* src, size_t n) {
     return m_sdCard.writeBlocks(block, src, n);
   }
+  bool writeStart(uint32_t block, uint32_t n) {
+    return m_sdCard.writeStart(block, n);
+  }
+  bool writeData(const uint8_t* src) {
+    return m_sdCard.writeData(src);
+  }
+  bool writeStop() {
+    return m_sdCard.writeStop();
+  }
   SdSpiCard m_sdCard;
 };
 //==============================================================================
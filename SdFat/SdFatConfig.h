@@ -99,9 +99,24 @@ uint8_t const SOFT_SPI_SCK_PIN = 13;
  * Set USE_SD_CRC to 1 to use a smaller slower CRC-CCITT function.
  *
  * Set USE_SD_CRC to 2 to used a larger faster table driven CRC-CCITT function.
+ *
+ * SdSpiCard::setCrc() turns checking off and on again at run time.  With
+ * the fast custom SPI on AVR, the CRC of data read is computed while the
+ * next byte is received.
  */
 #define USE_SD_CRC 0
 //------------------------------------------------------------------------------
+/**
+ * Set USE_SD_READ_STREAM nonzero to keep the multiple block read of
+ * sequential file reads open from one FatFile::read() call to the next.
+ * It is ended by the first non-sequential read, any other command, or
+ * FatFile::sync() and close() of any file.
+ *
+ * The card only sees SCK while it is selected, other devices can use the
+ * bus while the read is open.
+ */
+#define USE_SD_READ_STREAM 1
+//------------------------------------------------------------------------------
 /**
  * Set ENABLE_SPI_TRANSACTION nonzero to enable the SPI transaction feature
  * of the standard Arduino SPI library.  You must include SPI.h in your
@@ -122,6 +137,20 @@ uint8_t const SOFT_SPI_SCK_PIN = 13;
  */
 #define ENABLE_SPI_YIELD 0
 //------------------------------------------------------------------------------
+/**
+ * Set USE_SPI_ASYNC nonzero to add receiveAsync() and sendAsync() to the
+ * SPI classes.  These functions start a transfer and return, a callback
+ * is called from an interrupt when the transfer is done.
+ *
+ * AVR uses the SPI interrupt, Due and STM32F1 use DMA.  Other SPI classes
+ * do the transfer before returning, then call the callback.
+ *
+ * On AVR the SPI interrupt can't be used by another library and each byte
+ * costs an interrupt, about 40 cycles.  This is more than a byte at
+ * SPI_FULL_SPEED so only use it with a slower SCK or short transfers.
+ */
+#define USE_SPI_ASYNC 0
+//------------------------------------------------------------------------------
 /**
  * Set FAT12_SUPPORT nonzero to enable use if FAT12 volumes.
  * FAT12 has not been well tested and requires additional flash.
@@ -165,15 +194,154 @@ const uint8_t SPI_SCK_INIT_DIVISOR = 128;
 #endif
 //------------------------------------------------------------------------------
 /**
- * Set USE_SEPARATE_FAT_CACHE nonzero to use a second 512 byte cache
- * for FAT table entries.  This improves performance for large writes
- * that are not a multiple of 512 bytes.
+ * Number of 512 byte blocks in the volume cache.  Directory, FAT and file
+ * data blocks share it, the least recently used block is replaced.  With
+ * more than one block a directory scan, a FAT lookup and a file read or
+ * append no longer read each other's blocks again.
+ *
+ * It may be set on the compiler command line, to compare cache sizes.
+ */
+#ifndef CACHE_BLOCK_COUNT
+#if defined(RAMEND) && RAMEND < 3000
+#define CACHE_BLOCK_COUNT 1
+#else  // RAMEND
+#define CACHE_BLOCK_COUNT 4
+#endif  // RAMEND
+#endif  // CACHE_BLOCK_COUNT
+//------------------------------------------------------------------------------
+/**
+ * Dirty cache blocks are written when they are replaced and by sync().
+ * Set CACHE_FLUSH_MILLIS nonzero to also write them when the last sync is
+ * older than this many milliseconds, at the next access to the cache.
+ * This bounds the data lost at a power cut for loggers that rarely call
+ * sync().  It must be less than 65536.
+ *
+ * With a single cache block, a file data block is written as soon as it
+ * is full.  With more, full blocks stay in the cache and blocks that
+ * follow each other on the card are written with one multiple block
+ * write.
+ *
+ * It may be set on the compiler command line, to turn it on for a logger.
+ */
+#ifndef CACHE_FLUSH_MILLIS
+#define CACHE_FLUSH_MILLIS 0
+#endif  // CACHE_FLUSH_MILLIS
+//------------------------------------------------------------------------------
+/**
+ * Set LAZY_FAT_MIRROR nonzero to write the second FAT when a file is
+ * closed, not each time a FAT block is written.  FAT blocks written
+ * by sync() are remembered as one run of blocks and copied to the second
+ * FAT with multiple block writes at close(), a block outside the run is
+ * mirrored at once.  A logger that calls sync() often writes each FAT
+ * block once per sync, not twice.
+ *
+ * The first FAT is the one in use, it is as current as without this
+ * option.  After a power cut only the second FAT may be behind, a check
+ * of the card copies the first one over it.
+ *
+ * It may be set on the compiler command line, to compare both ways.
+ */
+#ifndef LAZY_FAT_MIRROR
+#if defined(RAMEND) && RAMEND < 3000
+#define LAZY_FAT_MIRROR 0
+#else  // RAMEND
+#define LAZY_FAT_MIRROR 1
+#endif  // RAMEND
+#endif  // LAZY_FAT_MIRROR
+//------------------------------------------------------------------------------
+/**
+ * Set CACHE_STATS nonzero to count cache hits, misses and block I/O,
+ * returned by FatVolume::cacheStats().
+ */
+#ifndef CACHE_STATS
+#define CACHE_STATS 0
+#endif  // CACHE_STATS
+//------------------------------------------------------------------------------
+/**
+ * Number of extents, runs of contiguous clusters, each open file remembers
+ * from the start of its cluster chain.  They are recorded as the file is
+ * read, and a seek or a cluster crossing inside them needs no FAT access.
+ * A backward seek no longer follows the chain from the first cluster.
+ * Past the last extent the FAT is used as before.  Each extent uses
+ * eight bytes of RAM in each FatFile, zero disables them.
+ */
+#ifndef FILE_EXTENT_COUNT
+#if defined(RAMEND) && RAMEND < 3000
+#define FILE_EXTENT_COUNT 0
+#else  // RAMEND
+#define FILE_EXTENT_COUNT 8
+#endif  // RAMEND
+#endif  // FILE_EXTENT_COUNT
+//------------------------------------------------------------------------------
+/**
+ * Size in bytes of the free cluster map of the volume.  Each bit tells
+ * whether a group of clusters may hold a free cluster, the group size is
+ * set at mount for the map to cover the FAT.  Cluster allocation skips
+ * the groups known to be full without reading their FAT blocks.  Bits
+ * are cleared as allocation or freeClusterCount() find full groups and
+ * set when clusters are freed, zero disables the map.
+ *
+ * The free cluster count, from FSINFO or the first freeClusterCount(), is
+ * updated as clusters are allocated and freed, whatever the map size.
+ */
+#ifndef FREE_MAP_SIZE
+#if defined(RAMEND) && RAMEND < 3000
+#define FREE_MAP_SIZE 0
+#else  // RAMEND
+#define FREE_MAP_SIZE 64
+#endif  // RAMEND
+#endif  // FREE_MAP_SIZE
+//------------------------------------------------------------------------------
+/**
+ * Number of slots of the directory name index, a power of two.  The first
+ * open() by long name in a directory reads it all and keeps a hash of
+ * each name with the index of its first entry, four bytes a slot.  Later
+ * opens in that directory read the blocks of the names with the same hash
+ * only, a name not found still scans the directory.  Up to three quarters
+ * of the slots are used, the names past that are left out.
+ *
+ * N slots take 4*N bytes of RAM and index 3*N/4 names.  Size it for the
+ * largest directory opened by name: 2048 slots (8 KB) for 1536 names,
+ * 8192 slots (32 KB) for 6144 names.  A directory with many more names
+ * than that gains little.
+ *
+ * The index is for one directory at a time, opening a file by name in
+ * another directory builds it again.  remove() clears it, created files
+ * are added.  It needs USE_LONG_FILE_NAMES.
+ *
+ * Zero, the default, disables it.  It may be set on the compiler command
+ * line, on boards with RAM to spare.
+ */
+#ifndef DIR_INDEX_SIZE
+#define DIR_INDEX_SIZE 0
+#endif  // DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
+/**
+ * Size of the name of a dirInfo_t, filled by FatFile::readDir(dirInfo_t*,
+ * uint8_t, dirFilter_t).  Long names are cut to DIR_INFO_NAME_DIM - 1
+ * characters, like getName() does.  Each entry of an array given to
+ * readDir() takes DIR_INFO_NAME_DIM + 19 bytes.  It must hold a short
+ * name, 13 at least.
+ */
+#ifndef DIR_INFO_NAME_DIM
+#if defined(RAMEND) && RAMEND < 3000
+#define DIR_INFO_NAME_DIM 13
+#else  // RAMEND
+#define DIR_INFO_NAME_DIM 64
+#endif  // RAMEND
+#endif  // DIR_INFO_NAME_DIM
+//------------------------------------------------------------------------------
+/**
+ * Set USE_SEPARATE_FAT_CACHE nonzero to use a second cache of
+ * CACHE_BLOCK_COUNT blocks for FAT table entries.  This improves
+ * performance for large writes that are not a multiple of 512 bytes
+ * when the cache holds a single block.
  */
-#ifdef __arm__
+#if defined(__arm__) && CACHE_BLOCK_COUNT == 1
 #define USE_SEPARATE_FAT_CACHE 1
-#else  // __arm__
+#else  // defined(__arm__) && CACHE_BLOCK_COUNT == 1
 #define USE_SEPARATE_FAT_CACHE 0
-#endif  // __arm__
+#endif  // defined(__arm__) && CACHE_BLOCK_COUNT == 1
 //------------------------------------------------------------------------------
 /**
  * Set USE_MULTI_BLOCK_IO nonzero to use multi-block SD read/write.
@@ -27,6 +27,13 @@ int SdFatUtil::FreeRam() {
   char top;
   return &top - reinterpret_cast<char*>(sbrk(0));
 }
+#elif defined(ARDUINO_ARCH_HOST)
+/** Amount of free RAM
+ * \return Zero, free RAM is not tracked on the host.
+ */
+int SdFatUtil::FreeRam() {
+  return 0;
+}
 #else  // __arm__
 extern char *__brkval;
 extern char __bss_end;
@@ -112,6 +112,10 @@ uint8_t const SPI_QUARTER_SPEED = 8;
 uint8_t const SPI_EIGHTH_SPEED = 16;
 /** Set SCK rate to F_CPU/32. */
 uint8_t const SPI_SIXTEENTH_SPEED = 32;
+/** Slowest SCK rate a read CRC or token error backs off to. */
+uint8_t const SD_BACKOFF_MAX_DIVISOR = SPI_SIXTEENTH_SPEED;
+/** Blocks read at each SCK rate by SdSpiCard::tuneSckDivisor(). */
+uint8_t const SD_TUNE_BLOCK_COUNT = 16;
 //------------------------------------------------------------------------------
 // SD operation timeouts
 /** init timeout ms */
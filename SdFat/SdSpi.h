@@ -26,6 +26,12 @@
 #include <Arduino.h>
 #include "SdFatConfig.h"
 
+#if USE_SPI_ASYNC || defined(DOXYGEN)
+/** Function called from an interrupt at the end of an asynchronous transfer.
+ *  Its argument is zero for no error or a nonzero error code.
+ */
+typedef void (*SdSpiCallback_t)(uint8_t status);
+#endif  // USE_SPI_ASYNC || defined(DOXYGEN)
 //------------------------------------------------------------------------------
 /**
  * \class SdSpiBase
@@ -39,7 +45,7 @@ class SdSpiBase {
    *
    * \param[in] divisor SCK clock divider relative to the system clock.
    */
-  virtual void init(uint8_t divisor);
+  virtual void init(uint8_t divisor) = 0;
   /** Receive a byte.
    *
    * \return The byte.
@@ -64,6 +70,45 @@ class SdSpiBase {
   * \param[in] n Number of bytes to send.
   */
   virtual void send(const uint8_t* buf, size_t n) = 0;
+#if USE_SPI_ASYNC || defined(DOXYGEN)
+  /** Start receiving multiple bytes.  The default does the transfer
+   * before returning.
+   *
+   * \param[out] buf Buffer to receive the data, must be kept until done.
+   * \param[in] n Number of bytes to receive.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  virtual void receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+    uint8_t status = receive(buf, n);
+    if (done) {
+      done(status);
+    }
+  }
+  /** Start sending multiple bytes.  The default does the transfer
+   * before returning.
+   *
+   * \param[in] buf Buffer for data to be sent, must be kept until done.
+   * \param[in] n Number of bytes to send.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  virtual void sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+    send(buf, n);
+    if (done) {
+      done(0);
+    }
+  }
+  /** \return true while an asynchronous transfer is running. */
+  virtual bool asyncBusy() {
+    return false;
+  }
+  /** Wait for the end of an asynchronous transfer.
+   *
+   * \return Zero for no error or nonzero error code.
+   */
+  virtual uint8_t asyncWait() {
+    return 0;
+  }
+#endif  // USE_SPI_ASYNC || defined(DOXYGEN)
   /** \return true if hardware SPI else false */
   virtual bool useSpiTransactions() = 0;
 };
@@ -109,6 +154,29 @@ class SdSpi {
    * \param[in] n Number of bytes to send.
    */
   void send(const uint8_t* buf, size_t n);
+#if USE_SPI_ASYNC || defined(DOXYGEN)
+  /** Start receiving multiple bytes.
+   *
+   * \param[out] buf Buffer to receive the data, must be kept until done.
+   * \param[in] n Number of bytes to receive.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  void receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done);
+  /** Start sending multiple bytes.
+   *
+   * \param[in] buf Buffer for data to be sent, must be kept until done.
+   * \param[in] n Number of bytes to send.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  void sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done);
+  /** \return true while an asynchronous transfer is running. */
+  bool asyncBusy();
+  /** Wait for the end of an asynchronous transfer.
+   *
+   * \return Zero for no error or nonzero error code.
+   */
+  uint8_t asyncWait();
+#endif  // USE_SPI_ASYNC || defined(DOXYGEN)
   /** \return true - uses SPI transactions */
   bool useSpiTransactions() {
     return true;
@@ -178,9 +246,17 @@ class SdSpiLib {
    * \return Zero for no error or nonzero error code.
    */
   uint8_t receive(uint8_t* buf, size_t n) {
+#if defined(SPI_HAS_BLOCK_TRANSFER)
+    SPI.transfer(0, buf, n);
+#elif defined(SPI_HAS_TRANSACTION)
+    // The in-place block transfer of the core, FIFO or wide frames on ARM.
+    memset(buf, 0XFF, n);
+    SPI.transfer(buf, n);
+#else  // defined(SPI_HAS_BLOCK_TRANSFER)
     for (size_t i = 0; i < n; i++) {
       buf[i] = SPI.transfer(0XFF);
     }
+#endif  // defined(SPI_HAS_BLOCK_TRANSFER)
     return 0;
   }
   /** Send a byte.
@@ -196,10 +272,48 @@ class SdSpiLib {
    * \param[in] n Number of bytes to send.
    */
   void send(const uint8_t* buf , size_t n) {
+#if defined(SPI_HAS_BLOCK_TRANSFER)
+    SPI.transfer(buf, 0, n);
+#else  // defined(SPI_HAS_BLOCK_TRANSFER)
     for (size_t i = 0; i < n; i++) {
       SPI.transfer(buf[i]);
     }
+#endif  // defined(SPI_HAS_BLOCK_TRANSFER)
   }
+#if USE_SPI_ASYNC || defined(DOXYGEN)
+  /** Receive multiple bytes, then call done.
+   *
+   * \param[out] buf Buffer to receive the data.
+   * \param[in] n Number of bytes to receive.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  void receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+    uint8_t status = receive(buf, n);
+    if (done) {
+      done(status);
+    }
+  }
+  /** Send multiple bytes, then call done.
+   *
+   * \param[in] buf Buffer for data to be sent.
+   * \param[in] n Number of bytes to send.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  void sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+    send(buf, n);
+    if (done) {
+      done(0);
+    }
+  }
+  /** \return false - transfers end before returning */
+  bool asyncBusy() {
+    return false;
+  }
+  /** \return zero - transfers end before returning */
+  uint8_t asyncWait() {
+    return 0;
+  }
+#endif  // USE_SPI_ASYNC || defined(DOXYGEN)
   /** \return true - uses SPI transactions */
   bool useSpiTransactions() {
     return true;
@@ -242,9 +356,7 @@ class SdSpiSoft : public SdSpiBase {
   * \return Zero for no error or nonzero error code.
   */
   uint8_t receive(uint8_t* buf, size_t n) {
-    for (size_t i = 0; i < n; i++) {
-      buf[i] = receive();
-    }
+    m_spi.receive(buf, n);
     return 0;
   }
   /** Send a byte.
@@ -260,10 +372,42 @@ class SdSpiSoft : public SdSpiBase {
    * \param[in] n Number of bytes to send.
    */
   void send(const uint8_t* buf , size_t n) {
-    for (size_t i = 0; i < n; i++) {
-      send(buf[i]);
+    m_spi.send(buf, n);
+  }
+#if USE_SPI_ASYNC || defined(DOXYGEN)
+  /** Receive multiple bytes, then call done.
+   *
+   * \param[out] buf Buffer to receive the data.
+   * \param[in] n Number of bytes to receive.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  void receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+    uint8_t status = receive(buf, n);
+    if (done) {
+      done(status);
     }
   }
+  /** Send multiple bytes, then call done.
+   *
+   * \param[in] buf Buffer for data to be sent.
+   * \param[in] n Number of bytes to send.
+   * \param[in] done Function called at the end of the transfer, or NULL.
+   */
+  void sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+    send(buf, n);
+    if (done) {
+      done(0);
+    }
+  }
+  /** \return false - transfers end before returning */
+  bool asyncBusy() {
+    return false;
+  }
+  /** \return zero - transfers end before returning */
+  uint8_t asyncWait() {
+    return 0;
+  }
+#endif  // USE_SPI_ASYNC || defined(DOXYGEN)
   /** \return false - no SPI transactions */
   bool useSpiTransactions() {
     return false;
@@ -0,0 +1,84 @@
+/* Arduino SdSpi Library
+ * Copyright (C) 2013 by William Greiman
+ *
+ * This file is part of the Arduino SdSpi Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdSpi Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "SdSpi.h"
+#if defined(__AVR__) && USE_SPI_ASYNC
+#include <avr/interrupt.h>
+// The rest of the AVR SdSpi class is in-line in SdSpi.h.
+static const uint8_t* asyncTx;
+static uint8_t* asyncRx;
+static size_t asyncLeft;
+static SdSpiCallback_t asyncDone;
+static volatile bool asyncActive = false;
+//------------------------------------------------------------------------------
+// Send the first byte, the SPI interrupt does the rest.
+static void asyncStart(const uint8_t* tx, uint8_t* rx, size_t n,
+                       SdSpiCallback_t done) {
+  while (asyncActive) {}
+  if (n == 0) {
+    if (done) {
+      done(0);
+    }
+    return;
+  }
+  asyncTx = tx;
+  asyncRx = rx;
+  asyncLeft = n;
+  asyncDone = done;
+  asyncActive = true;
+  // Reading SPSR then writing SPDR clears SPIF left by a previous transfer.
+  uint8_t s = SPSR;
+  (void)s;
+  SPDR = tx ? *asyncTx++ : 0XFF;
+  SPCR |= 1 << SPIE;
+}
+//------------------------------------------------------------------------------
+ISR(SPI_STC_vect) {
+  uint8_t b = SPDR;
+  if (asyncRx) {
+    *asyncRx++ = b;
+  }
+  if (--asyncLeft) {
+    SPDR = asyncTx ? *asyncTx++ : 0XFF;
+    return;
+  }
+  SPCR &= ~(1 << SPIE);
+  asyncActive = false;
+  if (asyncDone) {
+    asyncDone(0);
+  }
+}
+//------------------------------------------------------------------------------
+void SdSpi::receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  asyncStart(0, buf, n, done);
+}
+//------------------------------------------------------------------------------
+void SdSpi::sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  asyncStart(buf, 0, n, done);
+}
+//------------------------------------------------------------------------------
+bool SdSpi::asyncBusy() {
+  return asyncActive;
+}
+//------------------------------------------------------------------------------
+uint8_t SdSpi::asyncWait() {
+  while (asyncActive) {}
+  return 0;
+}
+#endif  // defined(__AVR__) && USE_SPI_ASYNC
@@ -47,15 +47,12 @@ static uint8_t CRC7(const uint8_t* data, uint8_t n) {
 #if USE_SD_CRC == 1
 // slower CRC-CCITT
 // uses the x^16,x^12,x^5,x^1 polynomial.
-static uint16_t CRC_CCITT(const uint8_t *data, size_t n) {
-  uint16_t crc = 0;
-  for (size_t i = 0; i < n; i++) {
-    crc = (uint8_t)(crc >> 8) | (crc << 8);
-    crc ^= data[i];
-    crc ^= (uint8_t)(crc & 0xff) >> 4;
-    crc ^= crc << 12;
-    crc ^= (crc & 0xff) << 5;
-  }
+static inline uint16_t CRC_CCITT_BYTE(uint16_t crc, uint8_t b) {
+  crc = (uint8_t)(crc >> 8) | (crc << 8);
+  crc ^= b;
+  crc ^= (uint8_t)(crc & 0xff) >> 4;
+  crc ^= crc << 12;
+  crc ^= (crc & 0xff) << 5;
   return crc;
 }
 #elif USE_SD_CRC > 1  // CRC_CCITT
@@ -100,24 +97,28 @@ static const uint16_t crctab[] = {
   0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
   0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
 };
-static uint16_t CRC_CCITT(const uint8_t* data, size_t n) {
-  uint16_t crc = 0;
-  for (size_t i = 0; i < n; i++) {
+static inline uint16_t CRC_CCITT_BYTE(uint16_t crc, uint8_t b) {
 #ifdef __AVR__
-    crc = pgm_read_word(&crctab[(crc >> 8 ^ data[i]) & 0XFF]) ^ (crc << 8);
+  return pgm_read_word(&crctab[(crc >> 8 ^ b) & 0XFF]) ^ (crc << 8);
 #else  // __AVR__
-    crc = crctab[(crc >> 8 ^ data[i]) & 0XFF] ^ (crc << 8);
+  return crctab[(crc >> 8 ^ b) & 0XFF] ^ (crc << 8);
 #endif  // __AVR__
+}
+#endif  // CRC_CCITT
+//------------------------------------------------------------------------------
+static uint16_t CRC_CCITT(const uint8_t* data, size_t n, uint16_t crc = 0) {
+  for (size_t i = 0; i < n; i++) {
+    crc = CRC_CCITT_BYTE(crc, data[i]);
   }
   return crc;
 }
-#endif  // CRC_CCITT
 #endif  // USE_SD_CRC
 //==============================================================================
 // SdSpiCard member functions
 //------------------------------------------------------------------------------
 bool SdSpiCard::begin(m_spi_t* spi, uint8_t chipSelectPin, uint8_t sckDivisor) {
   m_errorCode = m_type = 0;
+  m_streamOpen = false;
   m_spi = spi;
   m_chipSelectPin = chipSelectPin;
   // 16-bit init start time allows over a minute
@@ -149,6 +150,7 @@ bool SdSpiCard::begin(m_spi_t* spi, uint8_t chipSelectPin, uint8_t sckDivisor) {
     error(SD_CARD_ERROR_CMD59);
     goto fail;
   }
+  m_crc = true;
 #endif  // USE_SD_CRC
   // check SD version
   while (1) {
@@ -203,11 +205,17 @@ fail:
 //------------------------------------------------------------------------------
 // send command and return error code.  Return zero for OK
 uint8_t SdSpiCard::cardCommand(uint8_t cmd, uint32_t arg) {
+  // end a read left open by readStream()
+  if (m_streamOpen && cmd != CMD12) {
+    readStreamStop();
+  }
   // select card
   chipSelectLow();
 
-  // wait if busy
-  waitNotBusy(SD_WRITE_TIMEOUT);
+  // wait if busy, CMD12 may interrupt a partly read block
+  if (cmd != CMD12 || m_partOffset == 0) {
+    waitNotBusy(SD_WRITE_TIMEOUT);
+  }
 
   uint8_t *pa = reinterpret_cast<uint8_t *>(&arg);
 
@@ -352,16 +360,24 @@ bool SdSpiCard::isBusy() {
 }
 //------------------------------------------------------------------------------
 bool SdSpiCard::readBlock(uint32_t blockNumber, uint8_t* dst) {
+  uint8_t divisor;
   SD_TRACE("RB", blockNumber);
   // use address if not SDHC card
   if (type() != SD_CARD_TYPE_SDHC) {
     blockNumber <<= 9;
   }
-  if (cardCommand(CMD17, blockNumber)) {
-    error(SD_CARD_ERROR_CMD17);
-    goto fail;
-  }
-  return readData(dst, 512);
+  do {
+    divisor = m_sckDivisor;
+    if (cardCommand(CMD17, blockNumber)) {
+      error(SD_CARD_ERROR_CMD17);
+      goto fail;
+    }
+    if (readData(dst, 512)) {
+      return true;
+    }
+    // read it again if the error slowed SCK down
+  } while (m_sckDivisor != divisor);
+  return false;
 
 fail:
   chipSelectHigh();
@@ -387,7 +403,7 @@ bool SdSpiCard::readData(uint8_t *dst) {
 //------------------------------------------------------------------------------
 bool SdSpiCard::readData(uint8_t* dst, size_t count) {
 #if USE_SD_CRC
-  uint16_t crc;
+  uint16_t crc = 0;
 #endif  // USE_SD_CRC
   // wait for start block token
   uint16_t t0 = millis();
@@ -398,21 +414,36 @@ bool SdSpiCard::readData(uint8_t* dst, size_t count) {
     }
   }
   if (m_status != DATA_START_BLOCK) {
-    error(SD_CARD_ERROR_READ);
+    readError(SD_CARD_ERROR_READ);
     goto fail;
   }
   // transfer data
-  if ((m_status = spiReceive(dst, count))) {
+#if USE_SD_CRC
+  if (m_crc) {
+    m_status = spiReceiveCrc(dst, count, &crc);
+  } else {
+    m_status = spiReceive(dst, count);
+  }
+#else  // USE_SD_CRC
+  m_status = spiReceive(dst, count);
+#endif  // USE_SD_CRC
+  if (m_status) {
     error(SD_CARD_ERROR_SPI_DMA);
     goto fail;
   }
 
 #if USE_SD_CRC
-  // get crc
-  crc = (spiReceive() << 8) | spiReceive();
-  if (crc != CRC_CCITT(dst, count)) {
-    error(SD_CARD_ERROR_READ_CRC);
-    goto fail;
+  if (m_crc) {
+    // get crc
+    uint16_t cardCrc = spiReceive() << 8;
+    cardCrc |= spiReceive();
+    if (cardCrc != crc) {
+      readError(SD_CARD_ERROR_READ_CRC);
+      goto fail;
+    }
+  } else {
+    spiReceive();
+    spiReceive();
   }
 #else
   // discard crc
@@ -427,6 +458,76 @@ fail:
   return false;
 }
 //------------------------------------------------------------------------------
+bool SdSpiCard::readDataPart(uint8_t* dst, size_t count) {
+  chipSelectLow();
+  if (m_partOffset == 0) {
+    // wait for start block token
+    uint16_t t0 = millis();
+    while ((m_status = spiReceive()) == 0XFF) {
+      if (((uint16_t)millis() - t0) > SD_READ_TIMEOUT) {
+        error(SD_CARD_ERROR_READ_TIMEOUT);
+        goto fail;
+      }
+    }
+    if (m_status != DATA_START_BLOCK) {
+      readError(SD_CARD_ERROR_READ);
+      goto fail;
+    }
+#if USE_SD_CRC
+    m_partCrc = 0;
+#endif  // USE_SD_CRC
+  }
+  if (count > 512U - m_partOffset) {
+    error(SD_CARD_ERROR_READ);
+    goto fail;
+  }
+#if USE_SD_CRC
+  if (m_crc) {
+    m_status = spiReceiveCrc(dst, count, &m_partCrc);
+  } else {
+    m_status = spiReceive(dst, count);
+  }
+#else  // USE_SD_CRC
+  m_status = spiReceive(dst, count);
+#endif  // USE_SD_CRC
+  if (m_status) {
+    error(SD_CARD_ERROR_SPI_DMA);
+    goto fail;
+  }
+  m_partOffset += count;
+  if (m_partOffset == 512) {
+    m_partOffset = 0;
+#if USE_SD_CRC
+    uint16_t crc = spiReceive() << 8;
+    crc |= spiReceive();
+    if (m_crc && crc != m_partCrc) {
+      readError(SD_CARD_ERROR_READ_CRC);
+      goto fail;
+    }
+#else  // USE_SD_CRC
+    // discard crc
+    spiReceive();
+    spiReceive();
+#endif  // USE_SD_CRC
+  }
+  chipSelectHigh();
+  return true;
+
+fail:
+  m_partOffset = 0;
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+// Bit errors in a block or its start token often come from an SCK rate the
+// card or the wiring can't follow : halve the rate for the next commands.
+void SdSpiCard::readError(uint8_t code) {
+  error(code);
+  if (m_sckDivisor < SD_BACKOFF_MAX_DIVISOR) {
+    m_sckDivisor <<= 1;
+  }
+}
+//------------------------------------------------------------------------------
 bool SdSpiCard::readOCR(uint32_t* ocr) {
   uint8_t *p = reinterpret_cast<uint8_t*>(ocr);
   if (cardCommand(CMD58, 0)) {
@@ -464,6 +565,7 @@ bool SdSpiCard::readStart(uint32_t blockNumber) {
   if (type() != SD_CARD_TYPE_SDHC) {
     blockNumber <<= 9;
   }
+  m_partOffset = 0;
   if (cardCommand(CMD18, blockNumber)) {
     error(SD_CARD_ERROR_CMD18);
     goto fail;
@@ -477,7 +579,10 @@ fail:
 }
 //------------------------------------------------------------------------------
 bool SdSpiCard::readStop() {
-  if (cardCommand(CMD12, 0)) {
+  uint8_t status = cardCommand(CMD12, 0);
+  m_partOffset = 0;
+  m_streamOpen = false;
+  if (status) {
     error(SD_CARD_ERROR_CMD12);
     goto fail;
   }
@@ -489,6 +594,160 @@ fail:
   return false;
 }
 //------------------------------------------------------------------------------
+bool SdSpiCard::readStream(uint32_t block, uint8_t* dst, size_t count) {
+#if USE_SD_READ_STREAM
+  SD_TRACE("RM", block);
+  if (!m_streamOpen || block != m_streamBlock || m_partOffset) {
+    // readStart() ends the previous read
+    if (!readStart(block)) {
+      return false;
+    }
+    m_streamOpen = true;
+    m_streamBlock = block;
+  }
+  for (size_t b = 0; b < count; b++, dst += 512) {
+    if (!readData(dst)) {
+      readStop();
+      return false;
+    }
+    m_streamBlock++;
+  }
+  return true;
+#else  // USE_SD_READ_STREAM
+  return count == 1 ? readBlock(block, dst) : readBlocks(block, dst, count);
+#endif  // USE_SD_READ_STREAM
+}
+//------------------------------------------------------------------------------
+bool SdSpiCard::readStreamPart(uint32_t block, uint16_t offset,
+                               uint8_t* dst, size_t count) {
+  if (count == 0) {
+    return true;
+  }
+  if (!m_streamOpen || block != m_streamBlock || offset != m_partOffset) {
+    // readStart() ends the previous read
+    if (!readStart(block)) {
+      return false;
+    }
+    m_streamOpen = true;
+    m_streamBlock = block;
+    // skip the start of the block, dst is used as scratch
+    for (uint16_t skip = 0; skip < offset; skip += count) {
+      size_t n = offset - skip < count ? offset - skip : count;
+      if (!readDataPart(dst, n)) {
+        goto fail;
+      }
+    }
+  }
+  if (!readDataPart(dst, count)) {
+    goto fail;
+  }
+  if (m_partOffset == 0) {
+    m_streamBlock++;
+  }
+  return true;
+
+fail:
+  readStop();
+  return false;
+}
+//------------------------------------------------------------------------------
+bool SdSpiCard::readStreamStop() {
+  return m_streamOpen ? readStop() : true;
+}
+#if USE_SD_CRC
+//------------------------------------------------------------------------------
+bool SdSpiCard::setCrc(bool enable) {
+  // CMD59 itself always has a valid CRC.
+  if (cardCommand(CMD59, enable)) {
+    error(SD_CARD_ERROR_CMD59);
+    goto fail;
+  }
+  m_crc = enable;
+  chipSelectHigh();
+  return true;
+
+fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+// Receive data and add it to crc.
+uint8_t SdSpiCard::spiReceiveCrc(uint8_t* buf, size_t n, uint16_t* crc) {
+#if defined(__AVR__) && SD_SPI_CONFIGURATION == 0
+  // The CRC of each byte is computed while the next one shifts in, it
+  // adds next to nothing to a read at F_CPU/2.
+  uint16_t c = *crc;
+  if (n-- == 0) {
+    return 0;
+  }
+  SPDR = 0XFF;
+  for (size_t i = 0; i < n; i++) {
+    while (!(SPSR & (1 << SPIF))) {}
+    uint8_t b = SPDR;
+    SPDR = 0XFF;
+    buf[i] = b;
+    c = CRC_CCITT_BYTE(c, b);
+  }
+  while (!(SPSR & (1 << SPIF))) {}
+  buf[n] = SPDR;
+  *crc = CRC_CCITT_BYTE(c, buf[n]);
+  return 0;
+#else  // defined(__AVR__) && SD_SPI_CONFIGURATION == 0
+  uint8_t status = spiReceive(buf, n);
+  *crc = CRC_CCITT(buf, n, *crc);
+  return status;
+#endif  // defined(__AVR__) && SD_SPI_CONFIGURATION == 0
+}
+#endif  // USE_SD_CRC
+//------------------------------------------------------------------------------
+uint8_t SdSpiCard::tuneSckDivisor(uint32_t blockNumber) {
+  uint16_t sum[SD_TUNE_BLOCK_COUNT];
+  uint8_t slow = m_sckDivisor;
+  if (!tuneRead(blockNumber, sum, false)) {
+    return 0;
+  }
+  for (uint8_t divisor = SPI_FULL_SPEED; divisor < slow; divisor <<= 1) {
+    m_sckDivisor = divisor;
+    if (tuneRead(blockNumber, sum, true)) {
+      return divisor;
+    }
+  }
+  m_sckDivisor = slow;
+  return slow;
+}
+//------------------------------------------------------------------------------
+// Read SD_TUNE_BLOCK_COUNT blocks and store the sum of each one in sum[],
+// or compare it with sum[] if check is true.
+bool SdSpiCard::tuneRead(uint32_t blockNumber, uint16_t* sum, bool check) {
+  uint8_t buf[32];
+  if (!readStart(blockNumber)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < SD_TUNE_BLOCK_COUNT; i++) {
+    // Fletcher style sums, they also see bytes swapped or shifted.
+    uint8_t s1 = 0;
+    uint8_t s2 = 0;
+    for (uint16_t n = 0; n < 512; n += sizeof(buf)) {
+      if (!readDataPart(buf, sizeof(buf))) {
+        goto fail;
+      }
+      for (uint8_t k = 0; k < sizeof(buf); k++) {
+        s1 += buf[k];
+        s2 += s1;
+      }
+    }
+    if (check && sum[i] != (s2 << 8 | s1)) {
+      goto fail;
+    }
+    sum[i] = s2 << 8 | s1;
+  }
+  return readStop();
+
+fail:
+  readStop();
+  return false;
+}
+//------------------------------------------------------------------------------
 // wait for card to go not busy
 bool SdSpiCard::waitNotBusy(uint16_t timeoutMillis) {
   uint16_t t0 = millis();
@@ -573,7 +832,7 @@ fail:
 // send one block of data for write block or write multiple blocks
 bool SdSpiCard::writeData(uint8_t token, const uint8_t* src) {
 #if USE_SD_CRC
-  uint16_t crc = CRC_CCITT(src, 512);
+  uint16_t crc = m_crc ? CRC_CCITT(src, 512) : 0XFFFF;
 #else  // USE_SD_CRC
   uint16_t crc = 0XFFFF;
 #endif  // USE_SD_CRC
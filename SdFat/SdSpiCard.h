@@ -41,7 +41,8 @@ class SdSpiCard {
   typedef SdSpiBase m_spi_t;
 #endif  // SD_SPI_CONFIGURATION < 3
   /** Construct an instance of SdSpiCard. */
-  SdSpiCard() : m_errorCode(SD_CARD_ERROR_INIT_NOT_CALLED), m_type(0) {}
+  SdSpiCard() : m_partOffset(0), m_streamOpen(false),
+    m_errorCode(SD_CARD_ERROR_INIT_NOT_CALLED), m_type(0) {}
   /** Initialize the SD card.
    * \param[in] spi SPI object.
    * \param[in] chipSelectPin SD chip select pin.
@@ -150,6 +151,21 @@ class SdSpiCard {
    * the value false is returned for failure.
    */
   bool readData(uint8_t *dst);
+  /** Read part of a data block in a multiple block read sequence.
+   *
+   * The card is deselected after each part so other SPI devices can use
+   * the bus in between.  The block ends, and its CRC is read, when its
+   * 512 bytes have been read.  readData() must not be called while a
+   * block is partly read.
+   *
+   * \param[out] dst Pointer to the location for the data to be read.
+   * \param[in] count Number of bytes to read, not more than the rest
+   *            of the block.
+   *
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool readDataPart(uint8_t* dst, size_t count);
   /** Read OCR register.
    *
    * \param[out] ocr Value of OCR register.
@@ -173,13 +189,85 @@ class SdSpiCard {
    * the value false is returned for failure.
    */
   bool readStop();
-  /** Return SCK divisor.
+  /** Read blocks in a multiple block read that is kept open.
+   *
+   * The read left open by the previous call goes on if block follows
+   * the blocks it returned, otherwise a new one is started at block.
+   * Any other command sent to the card ends it first, so sequential
+   * file reads cost one CMD18 instead of one command per block.
+   *
+   * With USE_SD_READ_STREAM zero the read is ended before returning.
+   *
+   * \param[in] block Logical block to be read.
+   * \param[out] dst Pointer to the location that will receive the data.
+   * \param[in] count Number of blocks to be read.
+   *
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool readStream(uint32_t block, uint8_t* dst, size_t count);
+  /** Read part of a block in a multiple block read that is kept open.
+   *
+   * Like readStream() but a few bytes at a time, with the card deselected
+   * in between : the read goes on if offset follows the bytes it returned
+   * last, otherwise a new one is started at block and the bytes before
+   * offset are skipped.  Any other command sent to the card ends it first.
+   * The read is kept open whatever USE_SD_READ_STREAM.
+   *
+   * \param[in] block Logical block to be read.
+   * \param[in] offset Position of the first byte in the block.
+   * \param[out] dst Pointer to the location that will receive the data.
+   * \param[in] count Number of bytes to read, not more than the rest
+   *            of the block.
+   *
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool readStreamPart(uint32_t block, uint16_t offset,
+                      uint8_t* dst, size_t count);
+  /** End the multiple block read left open by readStream() or
+   * readStreamPart(), if any.
+   *
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool readStreamStop();
+  /** Return SCK divisor.  A CRC or start token error on a read doubles
+   * it, up to SD_BACKOFF_MAX_DIVISOR, and readBlock() then reads the block
+   * again.
    *
    * \return Requested SCK divisor.
    */
   uint8_t sckDivisor() {
     return m_sckDivisor;
   }
+#if USE_SD_CRC || defined(DOXYGEN)
+  /** Turn CRC checking of commands and data on or off.  begin() turns
+   * it on.  The CRC of data read is computed while it is received.
+   *
+   * \param[in] enable true to check CRCs.
+   *
+   * \return true for success else false.
+   */
+  bool setCrc(bool enable);
+  /** \return true if CRCs are checked. */
+  bool crcEnabled() const {
+    return m_crc;
+  }
+#endif  // USE_SD_CRC || defined(DOXYGEN)
+  /** Find the fastest SCK rate the card reads at without errors.
+   *
+   * The blocks from blockNumber are read at the current rate, then at
+   * F_CPU/2, F_CPU/4 and so on until they read again with no error and
+   * with the same data.  With USE_SD_CRC the data CRC is checked too.
+   * The rate found is used from then on.
+   *
+   * \param[in] blockNumber First of the SD_TUNE_BLOCK_COUNT blocks read.
+   *
+   * \return The SCK divisor found, or zero if the blocks can't be read
+   * at the current rate.  The current rate is kept then.
+   */
+  uint8_t tuneSckDivisor(uint32_t blockNumber = 0);
   /** Return the card type: SD V1, SD V2 or SDHC
    * \return 0 - SD V1, 1 - SD V2, or 3 - SDHC.
    */
@@ -238,7 +326,12 @@ class SdSpiCard {
   }
   uint8_t cardCommand(uint8_t cmd, uint32_t arg);
   bool readData(uint8_t* dst, size_t count);
+  void readError(uint8_t code);
   bool readRegister(uint8_t cmd, void* buf);
+  bool tuneRead(uint32_t blockNumber, uint16_t* sum, bool check);
+#if USE_SD_CRC
+  uint8_t spiReceiveCrc(uint8_t* buf, size_t n, uint16_t* crc);
+#endif  // USE_SD_CRC
   void chipSelectHigh();
   void chipSelectLow();
   void spiYield();
@@ -270,6 +363,13 @@ class SdSpiCard {
   }
   m_spi_t* m_spi;
   uint8_t m_chipSelectPin;
+  uint16_t m_partOffset;
+  uint32_t m_streamBlock;
+  bool m_streamOpen;
+#if USE_SD_CRC
+  uint16_t m_partCrc;
+  bool m_crc;
+#endif  // USE_SD_CRC
   uint8_t m_errorCode;
   uint8_t m_sckDivisor;
   uint8_t m_status;
@@ -0,0 +1,101 @@
+/* Arduino SdSpi Library
+ * Copyright (C) 2013 by William Greiman
+ *
+ * This file is part of the Arduino SdSpi Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino SdSpi Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include "SdSpi.h"
+#if defined(ARDUINO_ARCH_HOST)
+#include <SPI.h>
+//------------------------------------------------------------------------------
+/** Initialize the SPI bus. */
+void SdSpi::begin() {
+  SPI.begin();
+}
+//------------------------------------------------------------------------------
+/** Set SPI options for access to SD/SDHC cards.
+ *
+ * \param[in] divisor SCK clock divider relative to the system clock.
+ */
+void SdSpi::init(uint8_t divisor) {
+  HostSpi.setDivisor(divisor);
+  HostSpi.setBitOrder(MSBFIRST);
+}
+//------------------------------------------------------------------------------
+/** Receive a byte.
+ *
+ * \return The byte.
+ */
+uint8_t SdSpi::receive() {
+  return HostSpi.transfer(0XFF, HOST_SPI_BYTE_OVERHEAD);
+}
+//------------------------------------------------------------------------------
+/** Receive multiple bytes.
+ *
+ * \param[out] buf Buffer to receive the data.
+ * \param[in] n Number of bytes to receive.
+ *
+ * \return Zero for no error or nonzero error code.
+ */
+uint8_t SdSpi::receive(uint8_t* buf, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    buf[i] = HostSpi.transfer(0XFF, HOST_SPI_BLOCK_OVERHEAD);
+  }
+  return 0;
+}
+//------------------------------------------------------------------------------
+/** Send a byte.
+ *
+ * \param[in] b Byte to send
+ */
+void SdSpi::send(uint8_t b) {
+  HostSpi.transfer(b, HOST_SPI_BYTE_OVERHEAD);
+}
+//------------------------------------------------------------------------------
+/** Send multiple bytes.
+ *
+ * \param[in] buf Buffer for data to be sent.
+ * \param[in] n Number of bytes to send.
+ */
+void SdSpi::send(const uint8_t* buf , size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    HostSpi.transfer(buf[i], HOST_SPI_BLOCK_OVERHEAD);
+  }
+}
+#if USE_SPI_ASYNC
+//------------------------------------------------------------------------------
+// The bus clocks the bytes as simulated time moves, like DMA.
+void SdSpi::receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  asyncWait();
+  HostSpi.startAsync(0, buf, n, done);
+}
+//------------------------------------------------------------------------------
+void SdSpi::sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  asyncWait();
+  HostSpi.startAsync(buf, 0, n, done);
+}
+//------------------------------------------------------------------------------
+bool SdSpi::asyncBusy() {
+  hostCycles(HOST_SPI_POLL_CYCLES);
+  return HostSpi.asyncBusy();
+}
+//------------------------------------------------------------------------------
+uint8_t SdSpi::asyncWait() {
+  while (asyncBusy()) {}
+  return 0;
+}
+#endif  // USE_SPI_ASYNC
+#endif  // defined(ARDUINO_ARCH_HOST)
@@ -215,4 +215,104 @@ void SdSpi::send(const uint8_t* buf , size_t n) {
   // leave RDR empty
   uint8_t b = pSpi->SPI_RDR;
 }
+#if USE_SPI_ASYNC
+#if USE_SAM3X_DMAC
+static SdSpiCallback_t asyncDone;
+static volatile bool asyncActive = false;
+static volatile uint8_t asyncStatus = 0;
+static uint32_t asyncChannel;
+//------------------------------------------------------------------------------
+// Interrupt at the end of the DMA block of the last channel started.
+static void asyncStart(uint32_t ch, SdSpiCallback_t done) {
+  while (asyncActive) {}
+  asyncChannel = ch;
+  asyncDone = done;
+  asyncStatus = 0;
+  asyncActive = true;
+  // reading EBCISR clears old status
+  uint32_t s = DMAC->DMAC_EBCISR;
+  DMAC->DMAC_EBCIER = DMAC_EBCIER_BTC0 << ch;
+  NVIC_EnableIRQ(DMAC_IRQn);
+}
+//------------------------------------------------------------------------------
+// End of an asynchronous transfer.
+static void asyncEnd(uint8_t status) {
+  Spi* pSpi = SPI0;
+  DMAC->DMAC_EBCIDR = DMAC_EBCIDR_BTC0 << asyncChannel;
+  if (asyncChannel == SPI_DMAC_TX_CH) {
+    while ((pSpi->SPI_SR & SPI_SR_TXEMPTY) == 0) {}
+    // leave RDR empty
+    uint8_t b = pSpi->SPI_RDR;
+  } else if (pSpi->SPI_SR & SPI_SR_OVRES) {
+    status |= 1;
+  }
+  asyncStatus = status;
+  asyncActive = false;
+  if (asyncDone) {
+    asyncDone(status);
+  }
+}
+//------------------------------------------------------------------------------
+void DMAC_Handler() {
+  uint32_t s = DMAC->DMAC_EBCISR;
+  if (asyncActive && (s & (DMAC_EBCISR_BTC0 << asyncChannel))) {
+    asyncEnd(0);
+  }
+}
+//------------------------------------------------------------------------------
+void SdSpi::receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  // clear overrun error
+  uint32_t s = SPI0->SPI_SR;
+  asyncStart(SPI_DMAC_RX_CH, done);
+  spiDmaRX(buf, n);
+  spiDmaTX(0, n);
+}
+//------------------------------------------------------------------------------
+void SdSpi::sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  while ((SPI0->SPI_SR & SPI_SR_TXEMPTY) == 0) {}
+  asyncStart(SPI_DMAC_TX_CH, done);
+  spiDmaTX(buf, n);
+}
+//------------------------------------------------------------------------------
+bool SdSpi::asyncBusy() {
+  return asyncActive;
+}
+//------------------------------------------------------------------------------
+uint8_t SdSpi::asyncWait() {
+  uint32_t m = millis();
+  while (asyncActive) {
+    if ((millis() - m) > SAM3X_DMA_TIMEOUT)  {
+      dmac_channel_disable(SPI_DMAC_RX_CH);
+      dmac_channel_disable(SPI_DMAC_TX_CH);
+      asyncEnd(2);
+      break;
+    }
+  }
+  return asyncStatus;
+}
+#else  // USE_SAM3X_DMAC
+//------------------------------------------------------------------------------
+void SdSpi::receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  uint8_t status = receive(buf, n);
+  if (done) {
+    done(status);
+  }
+}
+//------------------------------------------------------------------------------
+void SdSpi::sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  send(buf, n);
+  if (done) {
+    done(0);
+  }
+}
+//------------------------------------------------------------------------------
+bool SdSpi::asyncBusy() {
+  return false;
+}
+//------------------------------------------------------------------------------
+uint8_t SdSpi::asyncWait() {
+  return 0;
+}
+#endif  // USE_SAM3X_DMAC
+#endif  // USE_SPI_ASYNC
 #endif  // defined(__SAM3X8E__) || defined(__SAM3X8H__)
@@ -34,17 +34,50 @@
 
 volatile bool SPI_DMA_TX_Active = false;
 volatile bool SPI_DMA_RX_Active = false;
+#if USE_SPI_ASYNC
+/** Callback of the asynchronous transfer, called by the last DMA event. */
+static SdSpiCallback_t asyncDone = 0;
+/** True if the asynchronous transfer ends with the RX channel. */
+static bool asyncReceive;
+/** True while an asynchronous transfer is running. */
+static volatile bool asyncActive = false;
+
+/** End of an asynchronous transfer. */
+static void asyncEnd() {
+  if (!asyncReceive) {
+    // wait for the last byte to be clocked, leave RX register empty
+    while (spi_is_busy(SPI1)) {}
+    uint8_t b = spi_rx_reg(SPI1);
+  }
+  asyncActive = false;
+  SdSpiCallback_t done = asyncDone;
+  asyncDone = 0;
+  if (done) {
+    done(0);
+  }
+}
+#endif  // USE_SPI_ASYNC
 
 /** ISR for DMA TX event. */
 inline void SPI_DMA_TX_Event() {
   SPI_DMA_TX_Active = false;
   dma_disable(DMA1, SPI_DMAC_TX_CH);
+#if USE_SPI_ASYNC
+  if (asyncActive && !asyncReceive) {
+    asyncEnd();
+  }
+#endif  // USE_SPI_ASYNC
 }
 
 /** ISR for DMA RX event. */
 inline void SPI_DMA_RX_Event() {
   SPI_DMA_RX_Active = false;
   dma_disable(DMA1, SPI1_DMAC_RX_CH);
+#if USE_SPI_ASYNC
+  if (asyncActive && asyncReceive) {
+    asyncEnd();
+  }
+#endif  // USE_SPI_ASYNC
 }
 //------------------------------------------------------------------------------
 
@@ -168,4 +201,50 @@ void SdSpi::send(const uint8_t* buf , size_t n) {
   //  while (spi_is_rx_nonempty(SPI1))
   uint8_t b = spi_rx_reg(SPI1);
 }
+#if USE_SPI_ASYNC
+//------------------------------------------------------------------------------
+void SdSpi::receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+#if USE_STM32F1_DMAC
+  if (n) {
+    while (asyncActive) {}
+    asyncReceive = true;
+    asyncDone = done;
+    asyncActive = true;
+    spiDmaRX(buf, n);
+    spiDmaTX(0, n);
+    return;
+  }
+#endif  // USE_STM32F1_DMAC
+  uint8_t status = receive(buf, n);
+  if (done) {
+    done(status);
+  }
+}
+//------------------------------------------------------------------------------
+void SdSpi::sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+#if USE_STM32F1_DMAC
+  if (n) {
+    while (asyncActive) {}
+    asyncReceive = false;
+    asyncDone = done;
+    asyncActive = true;
+    spiDmaTX(buf, n);
+    return;
+  }
+#endif  // USE_STM32F1_DMAC
+  send(buf, n);
+  if (done) {
+    done(0);
+  }
+}
+//------------------------------------------------------------------------------
+bool SdSpi::asyncBusy() {
+  return asyncActive;
+}
+//------------------------------------------------------------------------------
+uint8_t SdSpi::asyncWait() {
+  while (asyncActive) {}
+  return 0;
+}
+#endif  // USE_SPI_ASYNC
 #endif  // USE_NATIVE_STM32F1_SPI
@@ -298,4 +298,29 @@ void SdSpi::send(const uint8_t* buf , size_t n) {
   }
 }
 #endif  // KINETISK
+#if USE_SPI_ASYNC
+//==============================================================================
+// No DMA yet, the transfer is done before the callback is called.
+void SdSpi::receiveAsync(uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  uint8_t status = receive(buf, n);
+  if (done) {
+    done(status);
+  }
+}
+//------------------------------------------------------------------------------
+void SdSpi::sendAsync(const uint8_t* buf, size_t n, SdSpiCallback_t done) {
+  send(buf, n);
+  if (done) {
+    done(0);
+  }
+}
+//------------------------------------------------------------------------------
+bool SdSpi::asyncBusy() {
+  return false;
+}
+//------------------------------------------------------------------------------
+uint8_t SdSpi::asyncWait() {
+  return 0;
+}
+#endif  // USE_SPI_ASYNC
 #endif  // defined(__arm__) && defined(CORE_TEENSY)
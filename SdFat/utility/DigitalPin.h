@@ -28,7 +28,34 @@
 #ifndef DigitalPin_h
 #define DigitalPin_h
 #include <Arduino.h>
-#ifdef __arm__
+#if defined(ARDUINO_ARCH_HOST)
+//------------------------------------------------------------------------------
+/** read pin value
+ * @param[in] pin Arduino pin number
+ * @return value read
+ */
+static inline __attribute__((always_inline))
+bool fastDigitalRead(uint8_t pin) {
+  return hostFastRead(pin);
+}
+//------------------------------------------------------------------------------
+/** Set pin value
+ * @param[in] pin Arduino pin number
+ * @param[in] level value to write
+ */
+static inline __attribute__((always_inline))
+void fastDigitalWrite(uint8_t pin, bool level) {
+  hostFastWrite(pin, level);
+}
+//------------------------------------------------------------------------------
+inline void fastDigitalToggle(uint8_t pin) {
+  fastDigitalWrite(pin, !hostPinOutput(pin));
+}
+//------------------------------------------------------------------------------
+inline void fastPinMode(uint8_t pin, bool mode) {
+  hostFastPinMode(pin, mode);
+}
+#elif defined(__arm__)
 #ifdef CORE_TEENSY
 //------------------------------------------------------------------------------
 /** read pin value
@@ -84,7 +111,7 @@ inline void fastDigitalToggle(uint8_t pin) {
 inline void fastPinMode(uint8_t pin, bool mode) {
   pinMode(pin, mode);
 }
-#else  // __arm__
+#else  // defined(ARDUINO_ARCH_HOST)
 #include <avr/io.h>
 #include <util/atomic.h>
 //------------------------------------------------------------------------------
@@ -577,7 +604,7 @@ void fastPinMode(uint8_t pin, bool mode) {
   fastBitWriteSafe(pinMap[pin].ddr, pinMap[pin].bit, mode);
 }
 
-#endif  // __arm__
+#endif  // defined(ARDUINO_ARCH_HOST)
 //------------------------------------------------------------------------------
 /** set pin configuration
  * @param[in] pin Arduino pin number
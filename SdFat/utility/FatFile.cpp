@@ -88,7 +88,7 @@ fail:
 }
 //------------------------------------------------------------------------------
 bool FatFile::close() {
-  bool rtn = sync();
+  bool rtn = sync() && (!isOpen() || m_vol->cacheMirror());
   m_attr = FILE_ATTR_CLOSED;
   return rtn;
 }
@@ -220,6 +220,62 @@ uint32_t FatFile::dirSize() {
   return 512UL*n;
 }
 //------------------------------------------------------------------------------
+// Record cluster as the index-th cluster of the chain if it follows the
+// clusters already in the extents.
+void FatFile::extentAdd(uint32_t index, uint32_t cluster) {
+#if FILE_EXTENT_COUNT
+  extent_t* ext;
+  if (index != m_extentClusters || cluster < 2) {
+    return;
+  }
+  if (index) {
+    // extend the last run if cluster is contiguous
+    ext = &m_extent[m_extentCount - 1];
+    if (cluster == ext->cluster + index - ext->index) {
+      m_extentClusters++;
+      return;
+    }
+  } else {
+    m_extentCount = 0;
+  }
+  if (m_extentCount < FILE_EXTENT_COUNT) {
+    ext = &m_extent[m_extentCount++];
+    ext->index = index;
+    ext->cluster = cluster;
+    m_extentClusters++;
+  }
+#else  // FILE_EXTENT_COUNT
+  (void)index;
+  (void)cluster;
+#endif  // FILE_EXTENT_COUNT
+}
+//------------------------------------------------------------------------------
+// Get the index-th cluster of the chain if it is in the extents.
+bool FatFile::extentFind(uint32_t index, uint32_t* cluster) {
+#if FILE_EXTENT_COUNT
+  uint8_t lo = 0;
+  uint8_t hi = m_extentCount;
+  if (index >= m_extentClusters) {
+    return false;
+  }
+  // last extent starting at or before index
+  while (hi - lo > 1) {
+    uint8_t mid = (lo + hi)/2;
+    if (m_extent[mid].index <= index) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  *cluster = m_extent[lo].cluster + index - m_extent[lo].index;
+  return true;
+#else  // FILE_EXTENT_COUNT
+  (void)index;
+  (void)cluster;
+  return false;
+#endif  // FILE_EXTENT_COUNT
+}
+//------------------------------------------------------------------------------
 int16_t FatFile::fgets(char* str, int16_t num, char* delim) {
   char ch;
   int16_t n = 0;
@@ -365,6 +421,20 @@ fail:
   return false;
 }
 //------------------------------------------------------------------------------
+// Move m_curCluster to the next cluster of the chain, the index-th one.
+// Return like FatVolume::fatGet().
+int8_t FatFile::nextCluster(uint32_t index) {
+  int8_t fg;
+  if (extentFind(index, &m_curCluster)) {
+    return 1;
+  }
+  fg = m_vol->fatGet(m_curCluster, &m_curCluster);
+  if (fg > 0) {
+    extentAdd(index, m_curCluster);
+  }
+  return fg;
+}
+//------------------------------------------------------------------------------
 bool FatFile::open(FatFileSystem* fs, const char* path, uint8_t oflag) {
   return open(fs->vwd(), path, oflag);
 }
@@ -474,6 +544,28 @@ bool FatFile::open(FatFile* dirFile, uint16_t index, uint8_t oflag) {
   }
   return true;
 
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+bool FatFile::open(FatVolume* vol, uint32_t dirCluster, uint16_t index,
+                   uint8_t oflag) {
+  FatFile dir;
+  if (dirCluster == 0) {
+    if (!dir.openRoot(vol)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  } else {
+    // A FAT32 root directory is a cluster chain too.
+    memset(&dir, 0, sizeof(FatFile));
+    dir.m_attr = FILE_ATTR_SUBDIR;
+    dir.m_flags = O_READ;
+    dir.m_vol = vol;
+    dir.m_firstCluster = dirCluster;
+  }
+  return open(&dir, index, oflag);
+
 fail:
   return false;
 }
@@ -732,9 +824,10 @@ int FatFile::read(void* buf, size_t nbyte) {
         if (m_curPosition == 0) {
           // use first cluster in file
           m_curCluster = isRoot32() ? m_vol->rootDirStart() : m_firstCluster;
+          extentAdd(0, m_curCluster);
         } else {
-          // get next cluster from FAT
-          fg = m_vol->fatGet(m_curCluster, &m_curCluster);
+          // get next cluster from extents or FAT
+          fg = nextCluster(m_curPosition >> (m_vol->clusterSizeShift() + 9));
           if (fg < 0) {
             DBG_FAIL_MACRO;
             goto fail;
@@ -750,14 +843,14 @@ int FatFile::read(void* buf, size_t nbyte) {
       }
       block = m_vol->clusterStartBlock(m_curCluster) + blockOfCluster;
     }
-    if (offset != 0 || toRead < 512 || block == m_vol->cacheBlockNumber()) {
+    if (offset != 0 || toRead < 512 || m_vol->cacheContains(block, 1)) {
       // amount to be read from current block
       n = 512 - offset;
       if (n > toRead) {
         n = toRead;
       }
       // read block to cache and copy data to caller
-      pc = m_vol->cacheFetchData(block, FatCache::CACHE_FOR_READ);
+      pc = m_vol->cacheFetchData(block, FatCache::CACHE_FOR_STREAM);
       if (!pc) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -774,15 +867,14 @@ int FatFile::read(void* buf, size_t nbyte) {
         }
       }
       n = 512*nb;
-      if (m_vol->cacheBlockNumber() <= block
-          && block < (m_vol->cacheBlockNumber() + nb)) {
+      if (m_vol->cacheContains(block, nb)) {
         // flush cache if a block is in the cache
         if (!m_vol->cacheSync()) {
           DBG_FAIL_MACRO;
           goto fail;
         }
       }
-      if (!m_vol->readBlocks(block, dst, nb)) {
+      if (!m_vol->readStream(block, dst, nb)) {
         DBG_FAIL_MACRO;
         goto fail;
       }
@@ -790,7 +882,7 @@ int FatFile::read(void* buf, size_t nbyte) {
     } else {
       // read single block
       n = 512;
-      if (!m_vol->readBlock(block, dst)) {
+      if (!m_vol->readStream(block, dst, 1)) {
         DBG_FAIL_MACRO;
         goto fail;
       }
@@ -977,6 +1069,78 @@ bool FatFile::rename(FatFile* dirFile, const char* newPath) {
   }
   return m_vol->cacheSync();
 
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+bool FatFile::reserve(uint32_t length) {
+  uint32_t count;
+  uint32_t first;
+  // clusters of the chain and the last one
+  uint32_t have = 0;
+  uint32_t last = 0;
+  // error if not a normal file or read-only
+  if (!isFile() || !(m_flags & O_WRITE)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (length == 0) {
+    return true;
+  }
+  count = ((length - 1) >> (m_vol->clusterSizeShift() + 9)) + 1;
+  // find the end of the chain, from the extents as far as they go
+  if (m_firstCluster) {
+    last = m_firstCluster;
+    extentAdd(0, last);
+    for (have = 1; have < count; have++) {
+      uint32_t next;
+      if (!extentFind(have, &next)) {
+        int8_t fg = m_vol->fatGet(last, &next);
+        if (fg < 0) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        if (fg == 0) {
+          break;
+        }
+        extentAdd(have, next);
+      }
+      last = next;
+    }
+  }
+  if (have >= count) {
+    return true;
+  }
+  count -= have;
+  if (m_vol->allocContiguous(count, &first)) {
+    // link the run in one FAT write
+    if (last && !m_vol->fatPut(last, first)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (!m_firstCluster) {
+      m_firstCluster = first;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+      extentAdd(have + i, first + i);
+    }
+  } else {
+    // no free run that long, a cluster at a time
+    while (count--) {
+      if (!m_vol->allocateCluster(last, &last)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (!m_firstCluster) {
+        m_firstCluster = last;
+      }
+      extentAdd(have++, last);
+    }
+  }
+  // insure sync() will update dir entry
+  m_flags |= F_FILE_DIR_DIRTY;
+  return sync();
+
 fail:
   return false;
 }
@@ -1128,15 +1292,25 @@ bool FatFile::seekSet(uint32_t pos) {
   nCur = (m_curPosition - 1) >> (m_vol->clusterSizeShift() + 9);
   nNew = (pos - 1) >> (m_vol->clusterSizeShift() + 9);
 
+  if (extentFind(nNew, &m_curCluster)) {
+    goto done;
+  }
   if (nNew < nCur || m_curPosition == 0) {
     // must follow chain from first cluster
     m_curCluster = isRoot32() ? m_vol->rootDirStart() : m_firstCluster;
-  } else {
-    // advance from curPosition
-    nNew -= nCur;
-  }
-  while (nNew--) {
-    if (m_vol->fatGet(m_curCluster, &m_curCluster) <= 0) {
+    nCur = 0;
+    extentAdd(0, m_curCluster);
+  }
+#if FILE_EXTENT_COUNT
+  // or from the end of the extents if closer
+  if (m_extentClusters > nCur + 1) {
+    nCur = m_extentClusters - 1;
+    extentFind(nCur, &m_curCluster);
+  }
+#endif  // FILE_EXTENT_COUNT
+  // advance from nCur
+  while (nCur < nNew) {
+    if (nextCluster(++nCur) <= 0) {
       DBG_FAIL_MACRO;
       goto fail;
     }
@@ -1160,6 +1334,11 @@ bool FatFile::sync() {
   if (!isOpen()) {
     return true;
   }
+  // Don't leave the card sending a sequential read, it may be removed next.
+  if (!m_vol->readStreamStop()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
 
   if (m_flags & F_FILE_DIR_DIRTY) {
     dir_t* dir = cacheDirEntry(FatCache::CACHE_FOR_WRITE);
@@ -1291,8 +1470,8 @@ bool FatFile::truncate(uint32_t length) {
     DBG_FAIL_MACRO;
     goto fail;
   }
-  // fileSize and length are zero - nothing to do
-  if (m_fileSize == 0) {
+  // no clusters - nothing to do
+  if (m_firstCluster == 0) {
     return true;
   }
 
@@ -1304,6 +1483,8 @@ bool FatFile::truncate(uint32_t length) {
     DBG_FAIL_MACRO;
     goto fail;
   }
+  // extents may hold freed clusters
+  extentClear();
   if (length == 0) {
     // free all clusters
     if (!m_vol->freeChain(m_firstCluster)) {
@@ -1377,8 +1558,9 @@ int FatFile::write(const void* buf, size_t nbyte) {
     uint16_t blockOffset = m_curPosition & 0X1FF;
     if (blockOfCluster == 0 && blockOffset == 0) {
       // start of new cluster
+      uint32_t index = m_curPosition >> (m_vol->clusterSizeShift() + 9);
       if (m_curCluster != 0) {
-        int8_t fg = m_vol->fatGet(m_curCluster, &m_curCluster);
+        int8_t fg = nextCluster(index);
         if (fg < 0) {
           DBG_FAIL_MACRO;
           goto fail;
@@ -1389,6 +1571,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
             DBG_FAIL_MACRO;
             goto fail;
           }
+          extentAdd(index, m_curCluster);
         }
       } else {
         if (m_firstCluster == 0) {
@@ -1401,6 +1584,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
         } else {
           m_curCluster = m_firstCluster;
         }
+        extentAdd(0, m_curCluster);
       }
     }
     // block for data write
@@ -1429,6 +1613,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
       }
       uint8_t* dst = pc->data + blockOffset;
       memcpy(dst, src, n);
+#if CACHE_BLOCK_COUNT == 1
       if (512 == (n + blockOffset)) {
         // Force write if block is full - improves large writes.
         if (!m_vol->cacheSyncData()) {
@@ -1436,6 +1621,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
           goto fail;
         }
       }
+#endif  // CACHE_BLOCK_COUNT == 1
 #if USE_MULTI_BLOCK_IO
     } else if (nToWrite >= 1024) {
       // use multiple block write command
@@ -1445,11 +1631,8 @@ int FatFile::write(const void* buf, size_t nbyte) {
         nBlock = maxBlocks;
       }
       n = 512*nBlock;
-      if (m_vol->cacheBlockNumber() <= block
-          && block < (m_vol->cacheBlockNumber() + nBlock)) {
-        // invalidate cache if block is in cache
-        m_vol->cacheInvalidate();
-      }
+      // invalidate cache if block is in cache
+      m_vol->cacheInvalidate(block, nBlock);
       if (!m_vol->writeBlocks(block, src, nBlock)) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -1458,9 +1641,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
     } else {
       // use single block write command
       n = 512;
-      if (m_vol->cacheBlockNumber() == block) {
-        m_vol->cacheInvalidate();
-      }
+      m_vol->cacheInvalidate(block, 1);
       if (!m_vol->writeBlock(block, src)) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -101,6 +101,36 @@ const uint8_t FNAME_FLAG_NEED_LFN =
 const uint8_t FNAME_FLAG_LC_BASE = DIR_NT_LC_BASE;
 /** Filename extension is all lower case. */
 const uint8_t FNAME_FLAG_LC_EXT = DIR_NT_LC_EXT;
+//------------------------------------------------------------------------------
+/**
+ * \struct dirInfo_t
+ * \brief Directory entry decoded by FatFile::readDir(dirInfo_t*, uint8_t,
+ * dirFilter_t).
+ */
+struct dirInfo_t {
+  /** Long name, or short name if there is none. */
+  char name[DIR_INFO_NAME_DIM];
+  /** Size of the file in bytes. */
+  uint32_t fileSize;
+  /** First cluster, zero for an empty file. */
+  uint32_t firstCluster;
+  /** Index of the short name entry, for open(FatFile*, uint16_t, uint8_t). */
+  uint16_t index;
+  /** Creation date, FAT format. */
+  uint16_t creationDate;
+  /** Creation time, FAT format. */
+  uint16_t creationTime;
+  /** Last write date, FAT format. */
+  uint16_t lastWriteDate;
+  /** Last write time, FAT format. */
+  uint16_t lastWriteTime;
+  /** DIR_ATT_ bits of the entry. */
+  uint8_t attributes;
+};
+/** Filter of readDir(dirInfo_t*, uint8_t, dirFilter_t), an entry is kept
+ * if it returns true.
+ */
+typedef bool (*dirFilter_t)(const dirInfo_t* info);
 //==============================================================================
 /**
  * \class FatFile
@@ -203,7 +233,8 @@ class FatFile {
     return isFile() ? fileSize() - curPosition() : 0;
   }
   /** Close a file and force cached data and directory information
-   *  to be written to the storage device.
+   *  to be written to the storage device.  With LAZY_FAT_MIRROR, the
+   *  second FAT is brought up to date.
    *
    * \return The value true is returned for success and
    * the value false is returned for failure.
@@ -293,6 +324,13 @@ class FatFile {
   uint16_t dirIndex() {
     return m_dirIndex;
   }
+  /**
+   * \return The first cluster of this file's directory, zero for a FAT16
+   * root directory.
+   */
+  uint32_t dirCluster() const {
+    return m_dirCluster;
+  }
   /** Format the name field of \a dir into the 13 byte array
    * \a name in standard 8.3 short name format.
    *
@@ -497,6 +535,26 @@ class FatFile {
    * \return true for success or false for failure.
    */
   bool open(FatFile* dirFile, uint16_t index, uint8_t oflag);
+  /** Open a file by index, in a directory that isn't open.
+   *
+   * The file can be opened again this way whatever the working directory,
+   * from the values of dirCluster() and dirIndex() saved while it was open.
+   *
+   * \param[in] vol Volume of the directory.
+   *
+   * \param[in] dirCluster First cluster of the directory, zero for a FAT16
+   * root directory.
+   *
+   * \param[in] index The \a index of the directory entry for the file to be
+   * opened.
+   *
+   * \param[in] oflag bitwise-inclusive OR of open mode flags.
+   *                  See see FatFile::open(FatFile*, const char*, uint8_t).
+   *
+   * \return true for success or false for failure.
+   */
+  bool open(FatVolume* vol, uint32_t dirCluster, uint16_t index,
+            uint8_t oflag);
   /** Open a file or directory by name.
    *
    * \param[in] dirFile An open FatFile instance for the directory containing
@@ -702,6 +760,21 @@ class FatFile {
    * a directory file or an I/O error occurred.
    */
   int8_t readDir(dir_t* dir);
+  /** Read and decode the next entries of a directory file.
+   *
+   * The entries of a block are decoded from the cache one after the other,
+   * no file is opened and long names aren't read twice.  The '.' and '..'
+   * entries and volume labels are skipped.
+   *
+   * \param[out] info Array receiving the entries.
+   * \param[in] count Number of entries of \a info, at most 127.
+   * \param[in] filter Function choosing the entries kept, zero keeps them
+   * all.  It may use the volume.
+   *
+   * \return The number of entries read, zero at the end of the directory
+   * or -1 if an error occurs.
+   */
+  int8_t readDir(dirInfo_t* info, uint8_t count, dirFilter_t filter = 0);
   /** Remove a file.
    *
    * The directory entry and all data for the file are deleted.
@@ -742,6 +815,20 @@ class FatFile {
    * the value false is returned for failure.
    */
   bool rename(FatFile* dirFile, const char* newPath);
+  /** Allocate clusters for a file to grow to a length, without changing
+   * its size.  Writes up to \a length then find their clusters in the
+   * chain and don't touch the FAT.  The clusters are taken in one
+   * contiguous run if there is a free one long enough.
+   *
+   * \note The clusters beyond the size stay allocated when the file is
+   * closed, truncate(fileSize()) gives them back.
+   *
+   * \param[in] length The length the file is expected to reach.
+   *
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool reserve(uint32_t length);
   /** Remove a directory file.
    *
    * The directory file will be removed only if it is empty and is not the
@@ -949,11 +1036,22 @@ class FatFile {
   bool addCluster();
   bool addDirCluster();
   dir_t* cacheDirEntry(uint8_t action);
+  void extentAdd(uint32_t index, uint32_t cluster);
+  void extentClear() {
+#if FILE_EXTENT_COUNT
+    m_extentClusters = 0;
+#endif  // FILE_EXTENT_COUNT
+  }
+  bool extentFind(uint32_t index, uint32_t* cluster);
   static uint8_t lfnChecksum(uint8_t* name);
+  bool lfnIndex();
+  bool lfnMatch(fname_t* fname, uint16_t index,
+                uint16_t* sfnIndex, uint8_t* lfnOrd);
   bool lfnUniqueSfn(fname_t* fname);
   bool openCluster(FatFile* file);
   static bool parsePathName(const char* str, fname_t* fname, const char** ptr);
   bool mkdir(FatFile* parent, fname_t* fname);
+  int8_t nextCluster(uint32_t index);
   bool open(FatFile* dirFile, fname_t* fname, uint8_t oflag);
   bool openCachedEntry(FatFile* dirFile, uint16_t cacheIndex, uint8_t oflag,
                        uint8_t lfnOrd);
@@ -986,5 +1084,15 @@ class FatFile {
   uint32_t   m_dirBlock;         // block for this files directory entry
   uint32_t   m_fileSize;         // file size in bytes
   uint32_t   m_firstCluster;     // first cluster of file
+#if FILE_EXTENT_COUNT
+  // Run of contiguous clusters in the chain.
+  struct extent_t {
+    uint32_t index;    // index in the chain of its first cluster
+    uint32_t cluster;  // its first cluster
+  };
+  uint32_t   m_extentClusters;   // clusters of the chain in m_extent
+  uint8_t    m_extentCount;      // extents used
+  extent_t   m_extent[FILE_EXTENT_COUNT];
+#endif  // FILE_EXTENT_COUNT
 };
 #endif  // FatFile_h
@@ -81,6 +81,42 @@ static bool lfnGetName(ldir_t *ldir, char* name, size_t n) {
   return true;
 }
 //------------------------------------------------------------------------------
+// The characters of an LFN entry match their part of fname.
+static bool lfnCmp(ldir_t* ldir, fname_t* fname) {
+  size_t k = 13*((ldir->ord & 0X1F) - 1);
+  if (k >= fname->len) {
+    return false;
+  }
+  for (uint8_t i = 0; i < 13; i++) {
+    uint16_t u = lfnGetChar(ldir, i);
+    if (k == fname->len) {
+      return u == 0;
+    }
+    if (u > 255 || lfnToLower(u) != lfnToLower(fname->lfn[k++])) {
+      return false;
+    }
+  }
+  return true;
+}
+#if DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
+// Hash of a name for the directory index, whatever the case.  The 13
+// character parts, one per LFN entry, are hashed apart so entries read
+// last part first give the same hash.
+static uint16_t lfnHash(const char* str, size_t len) {
+  char part[13];
+  uint16_t hash = 0;
+  for (size_t k = 0; k < len; k += 13) {
+    uint8_t n;
+    for (n = 0; n < 13 && k + n < len; n++) {
+      part[n] = lfnToLower(str[k + n]);
+    }
+    hash ^= Bernstein(k/13 + 1, part, n);
+  }
+  return hash;
+}
+#endif  // DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
 inline bool lfnLegalChar(char c) {
   if (c == '/' || c == '\\' || c == '"' || c == '*' ||
       c == ':' || c == '<' || c == '>' || c == '?' || c == '|') {
@@ -305,6 +341,25 @@ bool FatFile::open(FatFile* dirFile, fname_t* fname, uint8_t oflag) {
   // Number of directory entries needed.
   freeNeed = fname->flags & FNAME_FLAG_NEED_LFN ? 1 + (len + 12)/13 : 1;
 
+#if DIR_INDEX_SIZE
+  // Names in the index first, the scan finds the others.
+  if (!dirFile->m_vol->dirIndexFor(dirFile->m_firstCluster)
+      && !dirFile->lfnIndex()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  {
+    uint16_t hash = lfnHash(fname->lfn, len);
+    uint16_t slot = hash;
+    uint16_t index;
+    while (dirFile->m_vol->dirIndexNext(hash, &slot, &index)) {
+      if (dirFile->lfnMatch(fname, index, &curIndex, &lfnOrd)) {
+        goto found;
+      }
+    }
+    lfnOrd = 0;
+  }
+#endif  // DIR_INDEX_SIZE
   dirFile->rewind();
   while (1) {
     curIndex = dirFile->m_curPosition/32;
@@ -347,26 +402,9 @@ bool FatFile::open(FatFile* dirFile, fname_t* fname, uint8_t oflag) {
         lfnOrd = 0;
         continue;
       }
-      size_t k = 13*(ord - 1);
-      if (k >= len) {
+      if (!lfnCmp(ldir, fname)) {
         // Not found.
         lfnOrd = 0;
-        continue;
-      }
-      for (uint8_t i = 0; i < 13; i++) {
-        uint16_t u = lfnGetChar(ldir, i);
-        if (k == len) {
-          if (u != 0) {
-            // Not found.
-            lfnOrd = 0;
-          }
-          break;
-        }
-        if (u > 255 || lfnToLower(u) != lfnToLower(fname->lfn[k++])) {
-          // Not found.
-          lfnOrd = 0;
-          break;
-        }
       }
     } else if (DIR_IS_FILE_OR_SUBDIR(dir)) {
       if (lfnOrd) {
@@ -482,6 +520,11 @@ create:
 
   // Force write of entry to device.
   dirFile->m_vol->cacheDirty();
+#if DIR_INDEX_SIZE
+  if (dirFile->m_vol->dirIndexFor(dirFile->m_firstCluster)) {
+    dirFile->m_vol->dirIndexAdd(lfnHash(fname->lfn, len), freeIndex);
+  }
+#endif  // DIR_INDEX_SIZE
 
 open:
   // open entry in cache.
@@ -578,6 +621,9 @@ bool FatFile::remove() {
   // Set this file closed.
   m_attr = FILE_ATTR_CLOSED;
 
+  // The index may hold the name.
+  m_vol->dirIndexClear();
+
   // Write entry to device.
   if (!m_vol->cacheSync()) {
     DBG_FAIL_MACRO;
@@ -624,6 +670,129 @@ bool FatFile::remove() {
 fail:
   return false;
 }
+#if DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
+// Index the names of this directory, up to a full index.
+bool FatFile::lfnIndex() {
+  char name[13];
+  uint8_t ord = 0;
+  uint8_t chksum = 0;
+  uint16_t hash = 0;
+  uint16_t bgnIndex = 0;
+  uint16_t curIndex;
+  dir_t* dir;
+
+  m_vol->dirIndexInit(m_firstCluster);
+  rewind();
+  while (1) {
+    curIndex = m_curPosition/32;
+    dir = readDirCache(true);
+    if (!dir) {
+      if (getError()) {
+        m_vol->dirIndexClear();
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      // At EOF
+      return true;
+    }
+    if (dir->name[0] == DIR_NAME_FREE) {
+      return true;
+    }
+    if (dir->name[0] == DIR_NAME_DELETED || dir->name[0] == '.') {
+      ord = 0;
+    } else if (DIR_IS_LONG_NAME(dir)) {
+      ldir_t *ldir = reinterpret_cast<ldir_t*>(dir);
+      if (ldir->ord & LDIR_ORD_LAST_LONG_ENTRY) {
+        ord = ldir->ord & 0X1F;
+        chksum = ldir->chksum;
+        hash = 0;
+        bgnIndex = curIndex;
+      } else if (ord < 2 || ldir->ord != ord - 1 || chksum != ldir->chksum) {
+        ord = 0;
+        continue;
+      } else {
+        ord--;
+      }
+      uint8_t n;
+      for (n = 0; n < 13; n++) {
+        uint16_t u = lfnGetChar(ldir, n);
+        if (u == 0) {
+          break;
+        }
+        // Can't be opened by this name.
+        if (u > 255) {
+          ord = 0;
+          break;
+        }
+        name[n] = lfnToLower(u);
+      }
+      hash ^= Bernstein(ord, name, n);
+    } else if (DIR_IS_FILE_OR_SUBDIR(dir)) {
+      if (ord != 1 || lfnChecksum(dir->name) != chksum) {
+        // Short name only.
+        uint8_t n = dirName(dir, name);
+        hash = lfnHash(name, n);
+        bgnIndex = curIndex;
+      }
+      if (!m_vol->dirIndexAdd(hash, bgnIndex)) {
+        // Full, the names left are found by a scan.
+        return true;
+      }
+      ord = 0;
+    } else {
+      ord = 0;
+    }
+  }
+
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Match fname with the name starting at entry index of this directory.
+// Return with the short name entry in the cache, like the scan of open().
+bool FatFile::lfnMatch(fname_t* fname, uint16_t index,
+                       uint16_t* sfnIndex, uint8_t* lfnOrd) {
+  uint8_t ord = 0;
+  uint8_t chksum = 0;
+  dir_t* dir;
+  if (!seekSet(32UL*index)) {
+    return false;
+  }
+  while (1) {
+    *sfnIndex = m_curPosition/32;
+    dir = readDirCache();
+    if (!dir || dir->name[0] == DIR_NAME_DELETED
+        || dir->name[0] == DIR_NAME_FREE) {
+      return false;
+    }
+    if (DIR_IS_LONG_NAME(dir)) {
+      ldir_t *ldir = reinterpret_cast<ldir_t*>(dir);
+      if (!ord) {
+        if ((ldir->ord & LDIR_ORD_LAST_LONG_ENTRY) == 0) {
+          return false;
+        }
+        *lfnOrd = ord = ldir->ord & 0X1F;
+        chksum = ldir->chksum;
+      } else if (ldir->ord != --ord || chksum != ldir->chksum) {
+        return false;
+      }
+      if (!lfnCmp(ldir, fname)) {
+        return false;
+      }
+    } else if (DIR_IS_FILE_OR_SUBDIR(dir)) {
+      if (ord) {
+        return ord == 1 && lfnChecksum(dir->name) == chksum;
+      }
+      *lfnOrd = 0;
+      return !(fname->flags & FNAME_FLAG_LOST_CHARS)
+             && !memcmp(dir->name, fname->sfn, sizeof(fname->sfn));
+    } else {
+      return false;
+    }
+  }
+}
+#endif  // DIR_INDEX_SIZE
 //------------------------------------------------------------------------------
 bool FatFile::lfnUniqueSfn(fname_t* fname) {
   const uint8_t FIRST_HASH_SEQ = 2;  // min value is 2
@@ -681,3 +850,81 @@ done:
   return true;
 }
 #endif  // #if USE_LONG_FILE_NAMES
+//------------------------------------------------------------------------------
+// The entries of a block are read from the cache without a call to read(),
+// except after the filter since it may have used the cache.
+int8_t FatFile::readDir(dirInfo_t* info, uint8_t count, dirFilter_t filter) {
+  uint8_t n = 0;
+  uint8_t lfnOrd = 0;
+  uint8_t chksum = 0;
+  bool fetch = true;
+  dir_t* dir;
+
+  if (!isDir() || (0X1F & m_curPosition)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  while (n < count) {
+    dirInfo_t* p = info + n;
+    uint16_t index = m_curPosition/32;
+    dir = readDirCache(!fetch);
+    fetch = false;
+    if (!dir) {
+      if (getError()) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      break;
+    }
+    // done if last entry
+    if (dir->name[0] == DIR_NAME_FREE) {
+      break;
+    }
+    if (dir->name[0] == DIR_NAME_DELETED || dir->name[0] == '.') {
+      lfnOrd = 0;
+    } else if (DIR_IS_FILE_OR_SUBDIR(dir)) {
+      if (lfnOrd != 1 || chksum != lfnChecksum(dir->name)) {
+        dirName(dir, p->name);
+      }
+      lfnOrd = 0;
+      p->fileSize = dir->fileSize;
+      p->firstCluster = (uint32_t)dir->firstClusterHigh << 16
+                        | dir->firstClusterLow;
+      p->index = index;
+      p->creationDate = dir->creationDate;
+      p->creationTime = dir->creationTime;
+      p->lastWriteDate = dir->lastWriteDate;
+      p->lastWriteTime = dir->lastWriteTime;
+      p->attributes = dir->attributes;
+      if (!filter) {
+        n++;
+      } else {
+        if (filter(p)) {
+          n++;
+        }
+        fetch = true;
+      }
+    } else if (DIR_IS_LONG_NAME(dir)) {
+#if USE_LONG_FILE_NAMES
+      // The parts of the name go straight to their place in p->name.
+      ldir_t* ldir = reinterpret_cast<ldir_t*>(dir);
+      uint8_t ord = ldir->ord & 0X1F;
+      if (ldir->ord & LDIR_ORD_LAST_LONG_ENTRY) {
+        chksum = ldir->chksum;
+      } else if (ord + 1 != lfnOrd || ldir->chksum != chksum) {
+        ord = 0;
+      }
+      lfnOrd = ord;
+      if (ord) {
+        lfnGetName(ldir, p->name, sizeof(p->name));
+      }
+#endif  // USE_LONG_FILE_NAMES
+    } else {
+      lfnOrd = 0;
+    }
+  }
+  return n;
+
+fail:
+  return -1;
+}
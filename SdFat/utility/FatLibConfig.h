@@ -67,16 +67,103 @@
 #endif  // ARDUINO_FILE_USES_STREAM
 //------------------------------------------------------------------------------
 /**
- * Set USE_SEPARATE_FAT_CACHE non-zero to use a second 512 byte cache
+ * Number of 512 byte blocks in the volume cache, the least recently used
+ * block is replaced.
+ */
+#ifndef CACHE_BLOCK_COUNT
+#if defined(RAMEND) && RAMEND < 3000
+#define CACHE_BLOCK_COUNT 1
+#else  // RAMEND
+#define CACHE_BLOCK_COUNT 4
+#endif  // RAMEND
+#endif  // CACHE_BLOCK_COUNT
+//------------------------------------------------------------------------------
+/**
+ * Set CACHE_FLUSH_MILLIS non-zero to write dirty cache blocks when the
+ * last sync is older than this many milliseconds.
+ */
+#ifndef CACHE_FLUSH_MILLIS
+#define CACHE_FLUSH_MILLIS 0
+#endif  // CACHE_FLUSH_MILLIS
+//------------------------------------------------------------------------------
+/**
+ * Set LAZY_FAT_MIRROR non-zero to write the second FAT at close(), not
+ * each time a FAT block is written.
+ */
+#ifndef LAZY_FAT_MIRROR
+#if defined(RAMEND) && RAMEND < 3000
+#define LAZY_FAT_MIRROR 0
+#else  // RAMEND
+#define LAZY_FAT_MIRROR 1
+#endif  // RAMEND
+#endif  // LAZY_FAT_MIRROR
+//------------------------------------------------------------------------------
+/**
+ * Set CACHE_STATS non-zero to count cache hits and misses.
+ */
+#ifndef CACHE_STATS
+#define CACHE_STATS 0
+#endif  // CACHE_STATS
+//------------------------------------------------------------------------------
+/**
+ * Number of contiguous cluster runs each open file remembers, zero
+ * disables them.
+ */
+#ifndef FILE_EXTENT_COUNT
+#if defined(RAMEND) && RAMEND < 3000
+#define FILE_EXTENT_COUNT 0
+#else  // RAMEND
+#define FILE_EXTENT_COUNT 8
+#endif  // RAMEND
+#endif  // FILE_EXTENT_COUNT
+//------------------------------------------------------------------------------
+/**
+ * Size in bytes of the map of cluster groups that may have free
+ * clusters, zero disables it.
+ */
+#ifndef FREE_MAP_SIZE
+#if defined(RAMEND) && RAMEND < 3000
+#define FREE_MAP_SIZE 0
+#else  // RAMEND
+#define FREE_MAP_SIZE 64
+#endif  // RAMEND
+#endif  // FREE_MAP_SIZE
+//------------------------------------------------------------------------------
+/**
+ * Number of slots of the name index of a directory, a power of two, zero
+ * disables it.  N slots take 4*N bytes and index 3*N/4 names.
+ */
+#ifndef DIR_INDEX_SIZE
+#define DIR_INDEX_SIZE 0
+#endif  // DIR_INDEX_SIZE
+#if !USE_LONG_FILE_NAMES
+// Only long file name lookups use the index.
+#undef DIR_INDEX_SIZE
+#define DIR_INDEX_SIZE 0
+#endif  // !USE_LONG_FILE_NAMES
+//------------------------------------------------------------------------------
+/**
+ * Size of the name of a dirInfo_t, long names are cut to fit.
+ */
+#ifndef DIR_INFO_NAME_DIM
+#if defined(RAMEND) && RAMEND < 3000
+#define DIR_INFO_NAME_DIM 13
+#else  // RAMEND
+#define DIR_INFO_NAME_DIM 64
+#endif  // RAMEND
+#endif  // DIR_INFO_NAME_DIM
+//------------------------------------------------------------------------------
+/**
+ * Set USE_SEPARATE_FAT_CACHE non-zero to use a second cache
  * for FAT table entries.  Improves performance for large writes that
- * are not a multiple of 512 bytes.
+ * are not a multiple of 512 bytes with a single block cache.
  */
 #ifndef USE_SEPARATE_FAT_CACHE
-#ifdef __arm__
+#if defined(__arm__) && CACHE_BLOCK_COUNT == 1
 #define USE_SEPARATE_FAT_CACHE 1
-#else  // __arm__
+#else  // defined(__arm__) && CACHE_BLOCK_COUNT == 1
 #define USE_SEPARATE_FAT_CACHE 0
-#endif  // __arm__
+#endif  // defined(__arm__) && CACHE_BLOCK_COUNT == 1
 #endif  // USE_SEPARATE_FAT_CACHE
 //------------------------------------------------------------------------------
 /**
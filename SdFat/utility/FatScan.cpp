@@ -0,0 +1,118 @@
+/* FatLib Library
+ * Copyright (C) 2013 by William Greiman
+ *
+ * This file is part of the FatLib Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the FatLib Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "FatScan.h"
+//------------------------------------------------------------------------------
+// Without a branch, a compiler turns these loops into SIMD where it has it.
+uint16_t fatCountFree(const void* fat, uint8_t fatType,
+                      uint16_t bgn, uint16_t end) {
+  uint16_t n = 0;
+  if (fatType == 32) {
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(fat);
+    for (uint16_t i = bgn; i < end; i++) {
+      n += (p[i] & 0X0FFFFFFF) == 0;
+    }
+  } else {
+    const uint16_t* p = reinterpret_cast<const uint16_t*>(fat);
+    for (uint16_t i = bgn; i < end; i++) {
+      n += p[i] == 0;
+    }
+  }
+  return n;
+}
+//------------------------------------------------------------------------------
+// An entry at a time, for the types a word doesn't hold several of.
+static uint16_t findEntry(const void* fat, uint8_t fatType,
+                          uint16_t bgn, uint16_t end, bool free) {
+  if (fatType == 32) {
+    const uint32_t* p = reinterpret_cast<const uint32_t*>(fat);
+    while (bgn < end && ((p[bgn] & 0X0FFFFFFF) == 0) != free) {
+      bgn++;
+    }
+  } else {
+    const uint16_t* p = reinterpret_cast<const uint16_t*>(fat);
+    while (bgn < end && (p[bgn] == 0) != free) {
+      bgn++;
+    }
+  }
+  return bgn;
+}
+#ifdef __AVR__
+//------------------------------------------------------------------------------
+// AVR has no fast wide words.
+static inline uint16_t find(const void* fat, uint8_t fatType,
+                            uint16_t bgn, uint16_t end, bool free) {
+  return findEntry(fat, fatType, bgn, end, free);
+}
+#else  // __AVR__
+#if UINTPTR_MAX > 0XFFFFFFFF
+typedef uint64_t word_t;
+#else  // UINTPTR_MAX
+typedef uint32_t word_t;
+#endif  // UINTPTR_MAX
+/** FAT16 entries in a word. */
+const uint8_t WORD_ENTRIES = sizeof(word_t)/2;
+/** Low 15 bits of each FAT16 entry of a word. */
+const word_t WORD_LOW = (word_t)-1/0XFFFF*0X7FFF;
+//------------------------------------------------------------------------------
+// High bit of each FAT16 entry of a word set if the entry is free.  The
+// carry of an entry with a low bit set reaches its high bit.
+static inline word_t freeBits(const uint16_t* p) {
+  word_t w;
+  memcpy(&w, p, sizeof(w));
+  return ~(((w & WORD_LOW) + WORD_LOW) | w | WORD_LOW);
+}
+//------------------------------------------------------------------------------
+// FAT16 a word at a time, entry index from the index of a bit.
+static uint16_t find(const void* fat, uint8_t fatType,
+                     uint16_t bgn, uint16_t end, bool free) {
+  if (fatType != 16) {
+    return findEntry(fat, fatType, bgn, end, free);
+  }
+  const uint16_t* p = reinterpret_cast<const uint16_t*>(fat);
+  const word_t high = ~WORD_LOW;
+  uint16_t i = bgn - bgn % WORD_ENTRIES;
+  // entries of the first word before bgn don't count
+  word_t skip = high << (16*(bgn - i)) & high;
+  for (; i < end; i += WORD_ENTRIES) {
+    word_t bits = freeBits(p + i);
+    if (!free) {
+      bits ^= high;
+    }
+    bits &= skip;
+    skip = high;
+    if (bits) {
+      i += __builtin_ctzll(bits)/16;
+      return i < end ? i : end;
+    }
+  }
+  return end;
+}
+#endif  // __AVR__
+//------------------------------------------------------------------------------
+uint16_t fatFindFree(const void* fat, uint8_t fatType,
+                     uint16_t bgn, uint16_t end) {
+  return find(fat, fatType, bgn, end, true);
+}
+//------------------------------------------------------------------------------
+uint16_t fatFindUsed(const void* fat, uint8_t fatType,
+                     uint16_t bgn, uint16_t end) {
+  return find(fat, fatType, bgn, end, false);
+}
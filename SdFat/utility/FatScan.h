@@ -0,0 +1,68 @@
+/* FatLib Library
+ * Copyright (C) 2013 by William Greiman
+ *
+ * This file is part of the FatLib Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the FatLib Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef FatScan_h
+#define FatScan_h
+/**
+ * \file
+ * \brief Scans of a FAT block for free or used entries
+ *
+ * Entries \a bgn to \a end - 1 of a FAT16 or FAT32 block are scanned.
+ * A free entry is zero, the four high bits of a FAT32 entry are ignored.
+ * Off AVR a search of a FAT16 block reads a machine word at a time, two to
+ * four entries are tested together.  A count is a loop without branches,
+ * the compiler vectorizes it where it can.
+ */
+#include <stdint.h>
+//------------------------------------------------------------------------------
+/** Count the free entries of a FAT block.
+ *
+ * \param[in] fat FAT block.
+ * \param[in] fatType 16 or 32.
+ * \param[in] bgn First entry.
+ * \param[in] end Entry after the last one.
+ *
+ * \return Number of free entries.
+ */
+uint16_t fatCountFree(const void* fat, uint8_t fatType,
+                      uint16_t bgn, uint16_t end);
+/** Find the first free entry of a FAT block.
+ *
+ * \param[in] fat FAT block.
+ * \param[in] fatType 16 or 32.
+ * \param[in] bgn First entry.
+ * \param[in] end Entry after the last one.
+ *
+ * \return Index of the entry, \a end if there is none.
+ */
+uint16_t fatFindFree(const void* fat, uint8_t fatType,
+                     uint16_t bgn, uint16_t end);
+/** Find the first used entry of a FAT block.  With fatFindFree() it finds
+ * runs of free entries.
+ *
+ * \param[in] fat FAT block.
+ * \param[in] fatType 16 or 32.
+ * \param[in] bgn First entry.
+ * \param[in] end Entry after the last one.
+ *
+ * \return Index of the entry, \a end if there is none.
+ */
+uint16_t fatFindUsed(const void* fat, uint8_t fatType,
+                     uint16_t bgn, uint16_t end);
+#endif  // FatScan_h
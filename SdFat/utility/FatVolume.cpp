@@ -20,79 +20,323 @@
 #include <string.h>
 #include "FatVolume.h"
 //------------------------------------------------------------------------------
+bool FatCache::contains(uint32_t lbn, uint32_t count) {
+  for (uint8_t i = 0; i < CACHE_BLOCK_COUNT; i++) {
+    if (m_lbn[i] - lbn < count) {
+      return true;
+    }
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+uint8_t FatCache::findDirty(uint32_t lbn, uint8_t status, uint8_t skip) {
+  for (uint8_t i = 0; i < CACHE_BLOCK_COUNT; i++) {
+    if (m_lbn[i] == lbn && m_status[i] == status && i != skip) {
+      return i;
+    }
+  }
+  return CACHE_BLOCK_COUNT;
+}
+//------------------------------------------------------------------------------
+void FatCache::init(FatVolume *vol) {
+  m_vol = vol;
+  m_cur = 0;
+#if LAZY_FAT_MIRROR
+  m_mirrorBgn = m_mirrorEnd = 0;
+#endif  // LAZY_FAT_MIRROR
+#if CACHE_FLUSH_MILLIS
+  m_syncMillis = millis();
+#endif  // CACHE_FLUSH_MILLIS
+  for (uint8_t i = 0; i < CACHE_BLOCK_COUNT; i++) {
+    m_order[i] = i;
+  }
+#if CACHE_STATS
+  memset(&stats, 0, sizeof(stats));
+#endif  // CACHE_STATS
+  invalidate();
+}
+//------------------------------------------------------------------------------
+void FatCache::invalidate() {
+  for (uint8_t i = 0; i < CACHE_BLOCK_COUNT; i++) {
+    m_status[i] = 0;
+    m_lbn[i] = 0XFFFFFFFF;
+  }
+}
+//------------------------------------------------------------------------------
+void FatCache::invalidate(uint32_t lbn, uint32_t count) {
+  for (uint8_t i = 0; i < CACHE_BLOCK_COUNT; i++) {
+    if (m_lbn[i] - lbn < count) {
+      m_status[i] = 0;
+      m_lbn[i] = 0XFFFFFFFF;
+    }
+  }
+}
+//------------------------------------------------------------------------------
+bool FatCache::mirror() {
+#if LAZY_FAT_MIRROR
+  uint8_t run[CACHE_BLOCK_COUNT];
+  uint32_t lbn = m_mirrorBgn;
+  uint32_t end = m_mirrorEnd;
+  // Forget the run first, read() may call sync().
+  m_mirrorBgn = m_mirrorEnd = 0;
+  while (lbn < end) {
+    // as many blocks as the cache holds in one write
+    uint8_t n = 0;
+    while (n < CACHE_BLOCK_COUNT && lbn + n < end) {
+      if (!read(lbn + n, CACHE_FOR_READ)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      run[n++] = m_cur;
+    }
+    if (!write(lbn + m_vol->blocksPerFat(), run, n)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    lbn += n;
+  }
+  return true;
+
+fail:
+  return false;
+#else  // LAZY_FAT_MIRROR
+  return true;
+#endif  // LAZY_FAT_MIRROR
+}
+//------------------------------------------------------------------------------
 cache_t* FatCache::read(uint32_t lbn, uint8_t option) {
-  if (m_lbn != lbn) {
-    if (!sync()) {
+  uint8_t i;
+  uint8_t k;
+#if CACHE_FLUSH_MILLIS
+  if ((uint16_t)millis() - m_syncMillis >= CACHE_FLUSH_MILLIS && !sync()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+#endif  // CACHE_FLUSH_MILLIS
+  // Most recently used first, it is the block asked for most of the time.
+  for (k = 0; k < CACHE_BLOCK_COUNT; k++) {
+    i = m_order[k];
+    if (m_lbn[i] == lbn) {
+      break;
+    }
+  }
+  if (k == CACHE_BLOCK_COUNT) {
+    // Replace the least recently used block.
+    k = CACHE_BLOCK_COUNT - 1;
+    i = m_order[k];
+    // The block used last is likely to be written again, keep it dirty.
+    if (!sync(i, m_order[0] != i ? m_order[0] : CACHE_BLOCK_COUNT)) {
       DBG_FAIL_MACRO;
       goto fail;
     }
-    if (!(option & CACHE_OPTION_NO_READ)) {
-      if (!m_vol->readBlock(lbn, m_block.data)) {
+    m_status[i] = 0;
+    m_lbn[i] = 0XFFFFFFFF;
+    if (option & CACHE_OPTION_STREAM) {
+      if (!m_vol->readStream(lbn, m_block[i].data, 1)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    } else if (!(option & CACHE_OPTION_NO_READ)) {
+      if (!m_vol->readBlock(lbn, m_block[i].data)) {
         DBG_FAIL_MACRO;
         goto fail;
       }
     }
-    m_status = 0;
-    m_lbn = lbn;
+    m_lbn[i] = lbn;
+#if CACHE_STATS
+    stats.misses++;
+    if (!(option & CACHE_OPTION_NO_READ)) {
+      stats.reads++;
+    }
+  } else {
+    stats.hits++;
+#endif  // CACHE_STATS
+  }
+  for (; k > 0; k--) {
+    m_order[k] = m_order[k - 1];
   }
-  m_status |= option & CACHE_STATUS_MASK;
-  return &m_block;
+  m_order[0] = i;
+  m_cur = i;
+  m_status[i] |= option & CACHE_STATUS_MASK;
+  return &m_block[i];
 
 fail:
   return 0;
 }
 //------------------------------------------------------------------------------
 bool FatCache::sync() {
-  if (m_status & CACHE_STATUS_DIRTY) {
-    if (!m_vol->writeBlock(m_lbn, m_block.data)) {
+  for (uint8_t i = 0; i < CACHE_BLOCK_COUNT; i++) {
+    if (!sync(i, CACHE_BLOCK_COUNT)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+#if CACHE_FLUSH_MILLIS
+  m_syncMillis = millis();
+#endif  // CACHE_FLUSH_MILLIS
+  return true;
+
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Write block i if dirty, with the dirty blocks that follow it or precede
+// it on the device.  Block skip is left out of the run.
+bool FatCache::sync(uint8_t i, uint8_t skip) {
+  uint8_t run[CACHE_BLOCK_COUNT];
+  uint8_t n = 0;
+  uint8_t status = m_status[i];
+  uint32_t lbn = m_lbn[i];
+  if (!(status & CACHE_STATUS_DIRTY)) {
+    return true;
+  }
+#if USE_MULTI_BLOCK_IO
+  // FAT blocks only join FAT blocks, they are mirrored.
+  while (findDirty(lbn - 1, status, skip) < CACHE_BLOCK_COUNT) {
+    lbn--;
+  }
+  while (n < CACHE_BLOCK_COUNT
+         && (run[n] = findDirty(lbn + n, status, skip)) < CACHE_BLOCK_COUNT) {
+    n++;
+  }
+#else  // USE_MULTI_BLOCK_IO
+  run[n++] = i;
+#endif  // USE_MULTI_BLOCK_IO
+  if (!write(lbn, run, n)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  // mirror second FAT
+  if (status & CACHE_STATUS_MIRROR_FAT) {
+#if LAZY_FAT_MIRROR
+    // Join the run waiting for mirror() if it is empty or touches it.
+    if (m_mirrorBgn == m_mirrorEnd) {
+      m_mirrorBgn = lbn;
+      m_mirrorEnd = lbn + n;
+    } else if (lbn <= m_mirrorEnd && m_mirrorBgn <= lbn + n) {
+      if (lbn < m_mirrorBgn) {
+        m_mirrorBgn = lbn;
+      }
+      if (lbn + n > m_mirrorEnd) {
+        m_mirrorEnd = lbn + n;
+      }
+    } else if (!write(lbn + m_vol->blocksPerFat(), run, n)) {
       DBG_FAIL_MACRO;
       goto fail;
     }
-    // mirror second FAT
-    if (m_status & CACHE_STATUS_MIRROR_FAT) {
-      uint32_t lbn = m_lbn + m_vol->blocksPerFat();
-      if (!m_vol->writeBlock(lbn, m_block.data)) {
+#else  // LAZY_FAT_MIRROR
+    if (!write(lbn + m_vol->blocksPerFat(), run, n)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+#endif  // LAZY_FAT_MIRROR
+  }
+  for (uint8_t k = 0; k < n; k++) {
+    m_status[run[k]] &= ~CACHE_STATUS_DIRTY;
+  }
+  return true;
+
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Write blocks run[0] to run[n - 1] of the cache from block lbn.
+bool FatCache::write(uint32_t lbn, const uint8_t* run, uint8_t n) {
+#if CACHE_STATS
+  stats.writes += n;
+  stats.writeCommands++;
+#endif  // CACHE_STATS
+#if USE_MULTI_BLOCK_IO
+  if (n > 1) {
+    if (!m_vol->writeStart(lbn, n)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    for (uint8_t k = 0; k < n; k++) {
+      if (!m_vol->writeData(m_block[run[k]].data)) {
         DBG_FAIL_MACRO;
         goto fail;
       }
     }
-    m_status &= ~CACHE_STATUS_DIRTY;
+    return m_vol->writeStop();
   }
-  return true;
+#endif  // USE_MULTI_BLOCK_IO
+  return m_vol->writeBlock(lbn, m_block[run[0]].data);
 
+#if USE_MULTI_BLOCK_IO
 fail:
   return false;
+#endif  // USE_MULTI_BLOCK_IO
 }
+#if CACHE_STATS
+//------------------------------------------------------------------------------
+void FatVolume::cacheStats(cache_stats_t* stats) {
+  *stats = m_cache.stats;
+#if USE_SEPARATE_FAT_CACHE
+  stats->hits += m_fatCache.stats.hits;
+  stats->misses += m_fatCache.stats.misses;
+  stats->reads += m_fatCache.stats.reads;
+  stats->writes += m_fatCache.stats.writes;
+#endif  // USE_SEPARATE_FAT_CACHE
+}
+#endif  // CACHE_STATS
 //------------------------------------------------------------------------------
 bool FatVolume::allocateCluster(uint32_t current, uint32_t* next) {
   uint32_t find = current ? current : m_allocSearchStart;
   uint32_t start = find;
+  // used clusters found in a row
+  uint32_t used = 0;
   while (1) {
     find++;
     // If at end of FAT go to beginning of FAT.
     if (find > m_lastCluster) {
       find = 2;
+      // clusters zero and one are reserved
+      used = 2;
+    }
+#if FREE_MAP_SIZE
+    if (freeMapFull(find)) {
+      // used up to the next map bit that may have free clusters
+      uint32_t skip = freeMapNext(find);
+      if (start >= find && start < skip) {
+        // Can't find space, the rest is used.
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      find = skip - 1;
+      used = 0;
+      continue;
     }
+#endif  // FREE_MAP_SIZE
     uint32_t f;
-    int8_t fg = fatGet(find, &f);
+    int8_t fg = fatFind(find, false, &f);
     if (fg < 0) {
       DBG_FAIL_MACRO;
       goto fail;
     }
-    if (fg && f == 0) {
-      break;
+    if (f != find) {
+      // clusters find to f - 1 are used
+      if (start - find < f - find) {
+        // Can't find space checked all clusters.
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      used += f - find;
+      freeMapUsed(f - 1, used);
     }
-    if (find == start) {
-      // Can't find space checked all clusters.
-      DBG_FAIL_MACRO;
-      goto fail;
+    if (fg) {
+      find = f;
+      break;
     }
+    // rest of the FAT block used
+    find = f - 1;
   }
   // mark end of chain
   if (!fatPutEOC(find)) {
     DBG_FAIL_MACRO;
     goto fail;
   }
+  freeCountAdd(-1);
   if (current) {
     // link clusters
     if (!fatPut(current, find)) {
@@ -120,6 +364,8 @@ bool FatVolume::allocContiguous(uint32_t count, uint32_t* firstCluster) {
   uint32_t endCluster;
   // Start at cluster after last allocated cluster.
   uint32_t startCluster = m_allocSearchStart;
+  // used clusters found in a row
+  uint32_t used = 0;
   endCluster = bgnCluster = startCluster + 1;
 
   // search the FAT for free clusters
@@ -127,31 +373,69 @@ bool FatVolume::allocContiguous(uint32_t count, uint32_t* firstCluster) {
     // If past end - start from beginning of FAT.
     if (endCluster > m_lastCluster) {
       bgnCluster = endCluster = 2;
+      used = 2;
+    }
+#if FREE_MAP_SIZE
+    if (freeMapFull(endCluster)) {
+      // used up to the next map bit that may have free clusters
+      uint32_t skip = freeMapNext(endCluster);
+      if (startCluster >= endCluster && startCluster < skip) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      bgnCluster = endCluster = skip;
+      used = 0;
+      setStart = false;
+      continue;
     }
+#endif  // FREE_MAP_SIZE
     uint32_t f;
-    int8_t fg = fatGet(endCluster, &f);
+    int8_t fg;
+    if (bgnCluster == endCluster) {
+      // find a free cluster to start the group
+      fg = fatFind(endCluster, false, &f);
+      if (fg < 0) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (f != endCluster) {
+        // Can't find space if all clusters checked.
+        if (startCluster - endCluster < f - endCluster) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        used += f - endCluster;
+        freeMapUsed(f - 1, used);
+        // don't update search start if unallocated clusters before f.
+        setStart = false;
+      }
+      bgnCluster = endCluster = f;
+      if (!fg) {
+        continue;
+      }
+    }
+    // extend the group to the next used cluster
+    fg = fatFind(endCluster, true, &f);
     if (fg < 0) {
       DBG_FAIL_MACRO;
       goto fail;
     }
-    if (f || fg == 0) {
-      // cluster in use try next cluster as bgnCluster
-      bgnCluster = endCluster + 1;
-
-      // don't update search start if unallocated clusters before endCluster.
-      if (bgnCluster != endCluster) {
-        setStart = false;
-      }
-    } else if ((endCluster - bgnCluster + 1) == count) {
+    if (f - bgnCluster >= count) {
       // done - found space
+      endCluster = bgnCluster + count - 1;
       break;
     }
     // Can't find space if all clusters checked.
-    if (startCluster == endCluster) {
+    if (startCluster - endCluster < f - endCluster) {
       DBG_FAIL_MACRO;
       goto fail;
     }
-    endCluster++;
+    used = 0;
+    endCluster = f;
+    if (fg) {
+      // cluster in use try next free cluster as bgnCluster
+      bgnCluster = f;
+    }
   }
   // remember possible next free cluster
   if (setStart) {
@@ -163,6 +447,7 @@ bool FatVolume::allocContiguous(uint32_t count, uint32_t* firstCluster) {
     DBG_FAIL_MACRO;
     goto fail;
   }
+  freeCountAdd(-(int32_t)count);
   // link clusters
   while (endCluster > bgnCluster) {
     if (!fatPut(endCluster - 1, endCluster)) {
@@ -183,6 +468,101 @@ uint32_t FatVolume::clusterStartBlock(uint32_t cluster) const {
   return m_dataStartBlock + ((cluster - 2) << m_clusterSizeShift);
 }
 //------------------------------------------------------------------------------
+// Add a name of the indexed directory, false if the index is full.
+bool FatVolume::dirIndexAdd(uint16_t hash, uint16_t index) {
+#if DIR_INDEX_SIZE
+  uint16_t slot = hash;
+  if (m_dirIndexCount >= 3*(DIR_INDEX_SIZE/4) || index == 0XFFFF) {
+    return false;
+  }
+  while (m_dirIndex[slot & (DIR_INDEX_SIZE - 1)].index != 0XFFFF) {
+    slot++;
+  }
+  m_dirIndex[slot & (DIR_INDEX_SIZE - 1)].hash = hash;
+  m_dirIndex[slot & (DIR_INDEX_SIZE - 1)].index = index;
+  m_dirIndexCount++;
+  return true;
+#else  // DIR_INDEX_SIZE
+  (void)hash;
+  (void)index;
+  return false;
+#endif  // DIR_INDEX_SIZE
+}
+//------------------------------------------------------------------------------
+// Start an empty index for the directory at cluster.
+void FatVolume::dirIndexInit(uint32_t cluster) {
+#if DIR_INDEX_SIZE
+  m_dirIndexCluster = cluster;
+  m_dirIndexCount = 0;
+  memset(m_dirIndex, 0XFF, sizeof(m_dirIndex));
+#else  // DIR_INDEX_SIZE
+  (void)cluster;
+#endif  // DIR_INDEX_SIZE
+}
+//------------------------------------------------------------------------------
+// Next name with this hash, from *slot on.  Start with *slot = hash.
+bool FatVolume::dirIndexNext(uint16_t hash, uint16_t* slot, uint16_t* index) {
+#if DIR_INDEX_SIZE
+  // A quarter of the slots at least are free, the probe ends.
+  while (1) {
+    dirIndex_t* e = &m_dirIndex[*slot & (DIR_INDEX_SIZE - 1)];
+    (*slot)++;
+    if (e->index == 0XFFFF) {
+      return false;
+    }
+    if (e->hash == hash) {
+      *index = e->index;
+      return true;
+    }
+  }
+#else  // DIR_INDEX_SIZE
+  (void)hash;
+  (void)slot;
+  (void)index;
+  return false;
+#endif  // DIR_INDEX_SIZE
+}
+//------------------------------------------------------------------------------
+// Find the first free, or used, cluster from cluster to the last one of
+// its FAT block.  Return -1 error, 0 none and found is the cluster after
+// the block, else 1.
+int8_t FatVolume::fatFind(uint32_t cluster, bool used, uint32_t* found) {
+  uint32_t next;
+  int8_t fg;
+  if (m_fatType == 32 || m_fatType == 16) {
+    uint8_t shift = m_fatType == 32 ? 7 : 8;
+    uint16_t mask = (1 << shift) - 1;
+    uint32_t first = cluster & ~(uint32_t)mask;
+    uint16_t end = m_lastCluster - first < mask ? m_lastCluster - first + 1
+                                                 : mask + 1;
+    cache_t* pc = cacheFetchFat(m_fatStartBlock + (cluster >> shift),
+                                FatCache::CACHE_FOR_READ);
+    if (!pc) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    uint16_t i = used ? fatFindUsed(pc->data, m_fatType, cluster & mask, end)
+                      : fatFindFree(pc->data, m_fatType, cluster & mask, end);
+    *found = first + i;
+    return i < end;
+  }
+  // FAT12, a cluster at a time
+  fg = fatGet(cluster, &next);
+  if (fg < 0) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if ((fg && next == 0) != used) {
+    *found = cluster;
+    return 1;
+  }
+  *found = cluster + 1;
+  return 0;
+
+fail:
+  return -1;
+}
+//------------------------------------------------------------------------------
 // Fetch a FAT entry - return -1 error, 0 EOC, else 1.
 int8_t FatVolume::fatGet(uint32_t cluster, uint32_t* value) {
   uint32_t lba;
@@ -337,6 +717,8 @@ bool FatVolume::freeChain(uint32_t cluster) {
       DBG_FAIL_MACRO;
       goto fail;
     }
+    freeCountAdd(1);
+    freeMapSet(cluster, true);
     if (cluster < m_allocSearchStart) {
       m_allocSearchStart = cluster;
     }
@@ -346,6 +728,8 @@ bool FatVolume::freeChain(uint32_t cluster) {
   return true;
 
 fail:
+  // count again
+  m_freeClusterCount = -1;
   return false;
 }
 //------------------------------------------------------------------------------
@@ -355,6 +739,13 @@ int32_t FatVolume::freeClusterCount() {
   uint32_t todo = m_lastCluster + 1;
   uint16_t n;
 
+  if (m_freeClusterCount >= 0) {
+    return m_freeClusterCount;
+  }
+#if FREE_MAP_SIZE
+  // set again from the FAT
+  memset(m_freeMap, 0, sizeof(m_freeMap));
+#endif  // FREE_MAP_SIZE
   if (FAT12_SUPPORT && m_fatType == 12) {
     for (unsigned i = 2; i < todo; i++) {
       uint32_t c;
@@ -365,6 +756,7 @@ int32_t FatVolume::freeClusterCount() {
       }
       if (fg && c == 0) {
         free++;
+        freeMapSet(i, true);
       }
     }
   } else if (m_fatType == 16 || m_fatType == 32) {
@@ -379,18 +771,11 @@ int32_t FatVolume::freeClusterCount() {
       if (todo < n) {
         n = todo;
       }
-      if (m_fatType == 16) {
-        for (uint16_t i = 0; i < n; i++) {
-          if (pc->fat16[i] == 0) {
-            free++;
-          }
-        }
-      } else {
-        for (uint16_t i = 0; i < n; i++) {
-          if (pc->fat32[i] == 0) {
-            free++;
-          }
-        }
+      uint16_t blockFree = fatCountFree(pc->data, m_fatType, 0, n);
+      free += blockFree;
+      if (blockFree) {
+        // a map bit holds whole FAT blocks
+        freeMapSet(m_lastCluster + 1 - todo, true);
       }
       todo -= n;
     }
@@ -399,11 +784,62 @@ int32_t FatVolume::freeClusterCount() {
     DBG_FAIL_MACRO;
     goto fail;
   }
+  m_freeClusterCount = free;
   return free;
 
 fail:
+#if FREE_MAP_SIZE
+  memset(m_freeMap, 0XFF, sizeof(m_freeMap));
+#endif  // FREE_MAP_SIZE
   return -1;
 }
+#if FREE_MAP_SIZE
+//------------------------------------------------------------------------------
+// First cluster from cluster on whose map bit is set, the clusters before
+// it are used.  m_lastCluster + 1 if there is none.
+uint32_t FatVolume::freeMapNext(uint32_t cluster) const {
+  uint32_t bit = cluster >> m_freeMapShift;
+  uint32_t end = (m_lastCluster >> m_freeMapShift) + 1;
+  while (bit < end) {
+    uint8_t b = m_freeMap[bit >> 3] >> (bit & 7);
+    if (b) {
+      bit += __builtin_ctz(b);
+      if (bit >= end) {
+        break;
+      }
+      uint32_t first = bit << m_freeMapShift;
+      return first > cluster ? first : cluster;
+    }
+    // rest of the byte is clear
+    bit = (bit | 7) + 1;
+  }
+  return m_lastCluster + 1;
+}
+#endif  // FREE_MAP_SIZE
+//------------------------------------------------------------------------------
+// Write the free count and allocation start to FSINFO if they changed.
+bool FatVolume::fsInfoSync() {
+  cache_t* pc;
+  uint32_t next = m_allocSearchStart < 2 ? 0XFFFFFFFF : m_allocSearchStart;
+  if (!m_fsInfoBlock ||
+      (m_fsInfoFree == (uint32_t)m_freeClusterCount && m_fsInfoNext == next)) {
+    return true;
+  }
+  pc = cacheFetchData(m_fsInfoBlock, FatCache::CACHE_FOR_WRITE);
+  if (!pc) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  // -1, not counted, is the unknown value of FSINFO
+  m_fsInfoFree = m_freeClusterCount;
+  m_fsInfoNext = next;
+  pc->fsinfo.freeCount = m_fsInfoFree;
+  pc->fsinfo.nextFree = m_fsInfoNext;
+  return true;
+
+fail:
+  return false;
+}
 //------------------------------------------------------------------------------
 bool FatVolume::init(uint8_t part) {
   uint32_t clusterCount;
@@ -414,6 +850,13 @@ bool FatVolume::init(uint8_t part) {
   uint8_t tmp;
   m_fatType = 0;
   m_allocSearchStart = 1;
+  m_freeClusterCount = -1;
+  m_fsInfoBlock = 0;
+  dirIndexClear();
+#if FREE_MAP_SIZE
+  // all the clusters may be free until the FAT is read
+  memset(m_freeMap, 0XFF, sizeof(m_freeMap));
+#endif  // FREE_MAP_SIZE
 
   m_cache.init(this);
 #if USE_SEPARATE_FAT_CACHE
@@ -487,6 +930,13 @@ bool FatVolume::init(uint8_t part) {
   // divide by cluster size to get cluster count
   clusterCount >>= m_clusterSizeShift;
   m_lastCluster = clusterCount + 1;
+#if FREE_MAP_SIZE
+  // A map bit holds at least one FAT block, 256 clusters.
+  for (m_freeMapShift = 8;
+       (m_lastCluster >> m_freeMapShift) >= 8UL*FREE_MAP_SIZE;
+       m_freeMapShift++) {
+  }
+#endif  // FREE_MAP_SIZE
 
   // FAT type is determined by cluster count
   if (clusterCount < 4085) {
@@ -500,6 +950,29 @@ bool FatVolume::init(uint8_t part) {
   } else {
     m_rootDirStart = fbs->fat32RootCluster;
     m_fatType = 32;
+    // Free count and allocation start kept by the last driver.
+    if (fbs->fat32FSInfo) {
+      // fbs is gone once FSINFO is read
+      m_fsInfoBlock = volumeStartBlock + fbs->fat32FSInfo;
+      pc = cacheFetchData(m_fsInfoBlock, FatCache::CACHE_FOR_READ);
+      if (!pc) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (pc->fsinfo.leadSignature != FSINFO_LEAD_SIG ||
+          pc->fsinfo.structSignature != FSINFO_STRUCT_SIG) {
+        m_fsInfoBlock = 0;
+      } else {
+        m_fsInfoFree = pc->fsinfo.freeCount;
+        m_fsInfoNext = pc->fsinfo.nextFree;
+        if (m_fsInfoFree <= clusterCount) {
+          m_freeClusterCount = m_fsInfoFree;
+        }
+        if (m_fsInfoNext >= 2 && m_fsInfoNext <= m_lastCluster) {
+          m_allocSearchStart = m_fsInfoNext;
+        }
+      }
+    }
   }
   return true;
 
@@ -520,6 +993,7 @@ bool FatVolume::wipe(print_t* pr) {
     DBG_FAIL_MACRO;
     goto fail;
   }
+  dirIndexClear();
   memset(cache->data, 0, 512);
   // Zero root.
   if (m_fatType == 32) {
@@ -566,6 +1040,9 @@ bool FatVolume::wipe(print_t* pr) {
     goto fail;
   }
   if (m_fatType == 32) {
+    // FSINFO values of the old FAT are wrong.
+    m_freeClusterCount = -1;
+    m_allocSearchStart = 1;
     // Reserve root cluster.
     if (!fatPutEOC(m_rootDirStart) || !cacheSync()) {
       DBG_FAIL_MACRO;
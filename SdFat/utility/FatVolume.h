@@ -26,6 +26,7 @@
 #include <stddef.h>
 #include "FatLibConfig.h"
 #include "FatStructs.h"
+#include "FatScan.h"
 //------------------------------------------------------------------------------
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 /** Macro for debug. */
@@ -86,10 +87,38 @@ union cache_t {
   /** Used to access to a cached FAT32 FSINFO sector. */
   fat32_fsinfo_t fsinfo;
 };
+#if CACHE_STATS || defined(DOXYGEN)
+//------------------------------------------------------------------------------
+/**
+ * \struct cache_stats_t
+ * \brief Cache counters, for cache size benchmarks.
+ */
+struct cache_stats_t {
+  /** Blocks asked for and found in the cache. */
+  uint32_t hits;
+  /** Blocks asked for and not found. */
+  uint32_t misses;
+  /** Blocks read from the device. */
+  uint32_t reads;
+  /** Blocks written to the device, FAT mirror included. */
+  uint32_t writes;
+  /** Write commands, a multiple block write counts once. */
+  uint32_t writeCommands;
+};
+#endif  // CACHE_STATS || defined(DOXYGEN)
 //==============================================================================
 /**
  * \class FatCache
  * \brief Block cache.
+ *
+ * Holds CACHE_BLOCK_COUNT blocks, the least recently used one is replaced
+ * by a new block.  block(), dirty() and lbn() apply to the block returned
+ * by the last call to read().
+ *
+ * Dirty blocks are written back when they are replaced, by sync(), and
+ * every CACHE_FLUSH_MILLIS.  Dirty blocks that follow each other on the
+ * device go out together in one multiple block write.  With
+ * LAZY_FAT_MIRROR, the second FAT copy of FAT blocks waits for mirror().
  */
 class FatCache {
  public:
@@ -109,45 +138,76 @@ class FatCache {
   /** Reserve cache block for write - do not read from block device. */
   static uint8_t const CACHE_RESERVE_FOR_WRITE
     = CACHE_STATUS_DIRTY | CACHE_OPTION_NO_READ;
+  /** Read with readStream(), the block is part of a sequential read. */
+  static const uint8_t CACHE_OPTION_STREAM = 8;
+  /** Cache file data block for a sequential read. */
+  static uint8_t const CACHE_FOR_STREAM = CACHE_OPTION_STREAM;
   /** \return Cache block address. */
   cache_t* block() {
-    return &m_block;
+    return &m_block[m_cur];
   }
+  /** \return true if a block of the range is in the cache.
+   * \param[in] lbn First block of the range.
+   * \param[in] count Number of blocks in the range.
+   */
+  bool contains(uint32_t lbn, uint32_t count);
   /** Set current block dirty. */
   void dirty() {
-    m_status |= CACHE_STATUS_DIRTY;
+    m_status[m_cur] |= CACHE_STATUS_DIRTY;
   }
   /** Initialize the cache.
    * \param[in] vol FatVolume that owns this FatCache.
    */
-  void init(FatVolume *vol) {
-    m_vol = vol;
-    invalidate();
-  }
-  /** Invalidate current cache block. */
-  void invalidate() {
-    m_status = 0;
-    m_lbn = 0XFFFFFFFF;
-  }
+  void init(FatVolume *vol);
+  /** Invalidate all cache blocks. */
+  void invalidate();
+  /** Invalidate the cache blocks of a range, dirty or not.
+   * \param[in] lbn First block of the range.
+   * \param[in] count Number of blocks in the range.
+   */
+  void invalidate(uint32_t lbn, uint32_t count);
   /** \return Logical block number for cached block. */
   uint32_t lbn() {
-    return m_lbn;
+    return m_lbn[m_cur];
   }
+  /** Copy the FAT blocks written by sync() since the last call to the
+   * second FAT.  Does nothing unless LAZY_FAT_MIRROR is set.
+   * \return true for success else false.
+   */
+  bool mirror();
   /** Read a block into the cache.
    * \param[in] lbn Block to read.
    * \param[in] option mode for cached block.
    * \return Address of cached block. */
   cache_t* read(uint32_t lbn, uint8_t option);
-  /** Write current block if dirty.
+  /** Write all dirty blocks.
    * \return true for success else false.
    */
   bool sync();
+#if CACHE_STATS || defined(DOXYGEN)
+  /** Counters since init(). */
+  cache_stats_t stats;
+#endif  // CACHE_STATS || defined(DOXYGEN)
 
  private:
-  uint8_t m_status;
+  uint8_t findDirty(uint32_t lbn, uint8_t status, uint8_t skip);
+  bool sync(uint8_t i, uint8_t skip);
+  bool write(uint32_t lbn, const uint8_t* run, uint8_t n);
+  uint8_t m_cur;
+#if LAZY_FAT_MIRROR
+  // FAT blocks written but not mirrored, first and after last.
+  uint32_t m_mirrorBgn;
+  uint32_t m_mirrorEnd;
+#endif  // LAZY_FAT_MIRROR
+#if CACHE_FLUSH_MILLIS
+  uint16_t m_syncMillis;
+#endif  // CACHE_FLUSH_MILLIS
+  // Block indexes, most recently used first.
+  uint8_t m_order[CACHE_BLOCK_COUNT];
+  uint8_t m_status[CACHE_BLOCK_COUNT];
   FatVolume* m_vol;
-  uint32_t m_lbn;
-  cache_t m_block;
+  uint32_t m_lbn[CACHE_BLOCK_COUNT];
+  cache_t m_block[CACHE_BLOCK_COUNT];
 };
 //==============================================================================
 /**
@@ -172,12 +232,30 @@ class FatVolume {
    * \return A pointer to the cache buffer or zero if an error occurs.
    */
   cache_t* cacheClear() {
-    if (!cacheSync()) {
+    if (!cacheSync() || !cacheMirror()) {
       return 0;
     }
     m_cache.invalidate();
     return m_cache.block();
   }
+  /** \return Address of the cache block used last.  Not for normal apps. */
+  cache_t *cacheAddress() {
+    return m_cache.block();
+  }
+  /** Drop the cached copies, dirty or not, of blocks written to the card
+   * directly.  Not for normal apps.
+   * \param[in] blockNumber First block of the range.
+   * \param[in] count Number of blocks in the range.
+   */
+  void cacheInvalidate(uint32_t blockNumber, uint32_t count) {
+    m_cache.invalidate(blockNumber, count);
+  }
+#if CACHE_STATS || defined(DOXYGEN)
+  /** Get the cache counters since init().  Not for normal apps.
+   * \param[out] stats Counters of all the volume caches.
+   */
+  void cacheStats(cache_stats_t* stats);
+#endif  // CACHE_STATS || defined(DOXYGEN)
   /** \return The total number of clusters in the volume. */
   uint32_t clusterCount() const {
     return m_lastCluster - 1;
@@ -202,7 +280,10 @@ class FatVolume {
   uint8_t fatType() const {
     return m_fatType;
   }
-  /** Volume free space in clusters.
+  /** Volume free space in clusters.  The count comes from the FSINFO
+   * block of a FAT32 volume when it holds one, else the FAT is read by the
+   * first call after init().  It is then kept as clusters are allocated
+   * and freed, and written to FSINFO by sync.
    *
    * \return Count of free clusters for success or -1 if an error occurs.
    */
@@ -271,6 +352,23 @@ class FatVolume {
   uint32_t m_fatStartBlock;        // Start block for first FAT.
   uint32_t m_lastCluster;          // Last cluster number in FAT.
   uint32_t m_rootDirStart;         // Start block for FAT16, cluster for FAT32.
+  int32_t  m_freeClusterCount;     // Free clusters, -1 if not counted yet.
+  uint32_t m_fsInfoBlock;          // FAT32 FSINFO block, zero if none.
+  uint32_t m_fsInfoFree;           // Free count in the FSINFO block.
+  uint32_t m_fsInfoNext;           // Next free hint in the FSINFO block.
+#if FREE_MAP_SIZE
+  uint8_t  m_freeMapShift;         // Cluster number to m_freeMap bit shift.
+  uint8_t  m_freeMap[FREE_MAP_SIZE];  // Bit clear if its clusters are used.
+#endif  // FREE_MAP_SIZE
+#if DIR_INDEX_SIZE
+  struct dirIndex_t {
+    uint16_t hash;                 // Hash of the name.
+    uint16_t index;                // First entry of the name.
+  };
+  uint32_t m_dirIndexCluster;      // Directory indexed, 0XFFFFFFFF for none.
+  uint16_t m_dirIndexCount;        // Names in m_dirIndex.
+  dirIndex_t m_dirIndex[DIR_INDEX_SIZE];  // Open addressing, index 0XFFFF free.
+#endif  // DIR_INDEX_SIZE
 //------------------------------------------------------------------------------
 // block caches
   FatCache m_cache;
@@ -281,7 +379,10 @@ class FatVolume {
                            options | FatCache::CACHE_STATUS_MIRROR_FAT);
   }
   bool cacheSync() {
-    return m_cache.sync() && m_fatCache.sync();
+    return fsInfoSync() && m_cache.sync() && m_fatCache.sync();
+  }
+  bool cacheMirror() {
+    return m_cache.mirror() && m_fatCache.mirror();
   }
 #else  //
   cache_t* cacheFetchFat(uint32_t blockNumber, uint8_t options) {
@@ -289,21 +390,21 @@ class FatVolume {
                           options | FatCache::CACHE_STATUS_MIRROR_FAT);
   }
   bool cacheSync() {
-    return m_cache.sync();
+    return fsInfoSync() && m_cache.sync();
+  }
+  bool cacheMirror() {
+    return m_cache.mirror();
   }
 #endif  // USE_SEPARATE_FAT_CACHE
   cache_t* cacheFetchData(uint32_t blockNumber, uint8_t options) {
     return m_cache.read(blockNumber, options);
   }
-  void cacheInvalidate() {
-    m_cache.invalidate();
+  bool cacheContains(uint32_t blockNumber, uint32_t count) {
+    return m_cache.contains(blockNumber, count);
   }
   bool cacheSyncData() {
     return m_cache.sync();
   }
-  cache_t *cacheAddress() {
-    return m_cache.block();
-  }
   uint32_t cacheBlockNumber() {
     return m_cache.lbn();
   }
@@ -317,12 +418,73 @@ class FatVolume {
     return (position >> 9) & m_clusterBlockMask;
   }
   uint32_t clusterStartBlock(uint32_t cluster) const;
+  bool dirIndexAdd(uint16_t hash, uint16_t index);
+  void dirIndexClear() {
+#if DIR_INDEX_SIZE
+    m_dirIndexCluster = 0XFFFFFFFF;
+#endif  // DIR_INDEX_SIZE
+  }
+  // The index is for the directory starting at cluster.
+  bool dirIndexFor(uint32_t cluster) const {
+#if DIR_INDEX_SIZE
+    return m_dirIndexCluster == cluster;
+#else  // DIR_INDEX_SIZE
+    (void)cluster;
+    return false;
+#endif  // DIR_INDEX_SIZE
+  }
+  void dirIndexInit(uint32_t cluster);
+  bool dirIndexNext(uint16_t hash, uint16_t* slot, uint16_t* index);
+  int8_t fatFind(uint32_t cluster, bool used, uint32_t* found);
   int8_t fatGet(uint32_t cluster, uint32_t* value);
   bool fatPut(uint32_t cluster, uint32_t value);
   bool fatPutEOC(uint32_t cluster) {
     return fatPut(cluster, 0x0FFFFFFF);
   }
   bool freeChain(uint32_t cluster);
+  void freeCountAdd(int32_t n) {
+    if (m_freeClusterCount >= 0) {
+      m_freeClusterCount += n;
+    }
+  }
+  // All the clusters of the map bit of cluster are used.
+  bool freeMapFull(uint32_t cluster) const {
+#if FREE_MAP_SIZE
+    cluster >>= m_freeMapShift;
+    return !(m_freeMap[cluster >> 3] & (1 << (cluster & 7)));
+#else  // FREE_MAP_SIZE
+    (void)cluster;
+    return false;
+#endif  // FREE_MAP_SIZE
+  }
+  uint32_t freeMapNext(uint32_t cluster) const;
+  bool fsInfoSync();
+  // A map bit is cleared when the used clusters found in a row fill it.
+  void freeMapUsed(uint32_t cluster, uint32_t used) {
+#if FREE_MAP_SIZE
+    uint32_t mask = (1UL << m_freeMapShift) - 1;
+    if (((cluster & mask) == mask || cluster == m_lastCluster)
+        && used > (cluster & mask)) {
+      freeMapSet(cluster, false);
+    }
+#else  // FREE_MAP_SIZE
+    (void)cluster;
+    (void)used;
+#endif  // FREE_MAP_SIZE
+  }
+  void freeMapSet(uint32_t cluster, bool mayBeFree) {
+#if FREE_MAP_SIZE
+    cluster >>= m_freeMapShift;
+    if (mayBeFree) {
+      m_freeMap[cluster >> 3] |= 1 << (cluster & 7);
+    } else {
+      m_freeMap[cluster >> 3] &= ~(1 << (cluster & 7));
+    }
+#else  // FREE_MAP_SIZE
+    (void)cluster;
+    (void)mayBeFree;
+#endif  // FREE_MAP_SIZE
+  }
   bool isEOC(uint32_t cluster) const {
     return cluster > m_lastCluster;
   }
@@ -330,9 +492,17 @@ class FatVolume {
   // Virtual block I/O functions.
   virtual bool readBlock(uint32_t block, uint8_t* dst) = 0;
   virtual bool writeBlock(uint32_t block, const uint8_t* src) = 0;
+  // Sequential file data, the device may keep the read open for the
+  // blocks that follow until readStreamStop().
+  virtual bool readStream(uint32_t block, uint8_t* dst, size_t nb) = 0;
+  virtual bool readStreamStop() = 0;
 #if USE_MULTI_BLOCK_IO
   virtual bool readBlocks(uint32_t block, uint8_t* dst, size_t nb) = 0;
   virtual bool writeBlocks(uint32_t block, const uint8_t* src, size_t nb) = 0;
+  // Multiple block write from blocks that are not next to each other in RAM.
+  virtual bool writeStart(uint32_t block, uint32_t nb) = 0;
+  virtual bool writeData(const uint8_t* src) = 0;
+  virtual bool writeStop() = 0;
 #endif  // USE_MULTI_BLOCK_IO
 };
 #endif  // FatVolume
@@ -106,6 +106,48 @@ class SoftSPI {
     transferBit(0, &rxData, txData);
     return rxData;
   }
+  //----------------------------------------------------------------------------
+  /** Soft SPI receive block.
+   * @param[out] buf Buffer to receive the data.
+   * @param[in] n Number of bytes to receive.
+   *
+   * MOSI is set high once for the block, 0XFF is sent.
+   */
+  void receive(uint8_t* buf, size_t n) {
+    fastDigitalWrite(MosiPin, true);
+    uint8_t* end = buf + n;
+    while (buf != end) {
+      *buf++ = receive();
+    }
+  }
+  //----------------------------------------------------------------------------
+  /** Soft SPI send block.
+   * @param[in] buf Buffer for data to be sent.
+   * @param[in] n Number of bytes to send.
+   */
+  void send(const uint8_t* buf, size_t n) {
+    const uint8_t* end = buf + n;
+    while (buf != end) {
+      send(*buf++);
+    }
+  }
+  //----------------------------------------------------------------------------
+  /** Soft SPI transfer block.
+   * @param[in] txBuf Data to send.
+   * @param[out] rxBuf Buffer to receive the data, may be txBuf.
+   * @param[in] n Number of bytes to transfer.
+   *
+   * The bytes sent and received can belong to two devices selected at the
+   * same time: a device that only listens, wired to MosiPin, and a device
+   * that only talks, wired to MisoPin with its own input held high.  A VS1011
+   * on MosiPin can get a buffer while an SD card on MisoPin gives the next
+   * one, in the time of a single transfer.
+   */
+  void transfer(const uint8_t* txBuf, uint8_t* rxBuf, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      rxBuf[i] = transfer(txBuf[i]);
+    }
+  }
 
  private:
   //----------------------------------------------------------------------------
@@ -24,10 +24,41 @@
 #include <Tune.h>
 #include <SdFat.h>
 #include <SPI.h>
+#include <utility/DigitalPin.h>
+#if SD_AUTO_SPEED
+#include <avr/eeprom.h>
+#endif
+
+// Pins known at compile time : each write or read is a single sbi/cbi/sbic on AVR
+static DigitalPin<DREQ> dreqPin;
+static DigitalPin<XDCS> xdcsPin;
+static DigitalPin<XCS> xcsPin;
+static DigitalPin<SDCS> sdcsPin;
 
 SdFat sd;
 SdFile Tune::track;
 byte Tune::buffer[32];
+volatile bool Tune::endOfTrack;
+byte Tune::cueBuffer[CUE_BUFFER_SIZE];
+unsigned int Tune::cueLength;
+unsigned int Tune::cueIndex;
+bool Tune::contiguous;
+#if STREAM_AHEAD
+byte Tune::streamAhead[32];
+unsigned int Tune::aheadLength;
+#endif
+uint32_t Tune::streamBlock;
+unsigned int Tune::streamOffset;
+uint32_t Tune::streamRemain;
+uint32_t Tune::trackEnd;
+unsigned int Tune::wavHeader;
+unsigned int Tune::headerRemain;
+unsigned int Tune::zeroRemain;
+clip_t* Tune::clip;
+SdFile Tune::clipFile;
+volatile bool Tune::clipActive;
+unsigned int Tune::clipIndex;
+uint32_t Tune::clipRemain;
 
 /** 
 	Initializes the shield : SPI & SD setup, reset of the VS1011e & clock setting
@@ -35,37 +66,55 @@ byte Tune::buffer[32];
 
 bool Tune::begin()
 {
-	// Pin configuration
-	pinMode(DREQ, INPUT_PULLUP);
-	pinMode(XDCS, OUTPUT);
-	pinMode(XCS, OUTPUT);
-	pinMode(SDCS, OUTPUT);
+	// Pin configuration : DREQ input with pull-up
+	dreqPin.config(INPUT, HIGH);
 	
 	// Deselect control & data ctrl
-	digitalWrite(XCS, HIGH);
-	digitalWrite(XDCS, HIGH);
+	xcsPin.config(OUTPUT, HIGH);
+	xdcsPin.config(OUTPUT, HIGH);
 	// Deselect SD's chip select
-	digitalWrite(SDCS, HIGH);
+	sdcsPin.config(OUTPUT, HIGH);
 	
 	// SD card initialization
+#if SD_AUTO_SPEED
+	// At the rate found on a previous run, if the card still reads at it
+	byte divisor = eeprom_read_byte((uint8_t*)SD_SPEED_EEPROM);
+	if (divisor != (byte)~eeprom_read_byte((uint8_t*)SD_SPEED_EEPROM + 1) || !sd.begin(SDCS, divisor))
+	{
+		// Otherwise from a safe rate, to get reference data for tuneSD()
+		if (!sd.begin(SDCS, SPI_QUARTER_SPEED))
+		{
+			sd.initErrorHalt(); // describe problem if there's one
+			return 0; 
+		}
+		tuneSD();
+	}
+#else
 	if (!sd.begin(SDCS, SPI_HALF_SPEED))
 	{
 		sd.initErrorHalt(); // describe problem if there's one
 		return 0; 
 	}
+#endif
 	
 	// Tracklisting also return the number of playable files
 	Serial.print(listFiles());
 	Serial.print(" tracks found, ");
 	
+	// Default play mode : tracklist order, looping around at the end
+	currentTrack = nb_track;
+	shuffle = 0;
+	repeatMode = REPEAT_ALL;
+	cued = 0;
+	
 	// SPI bus initialization
 	SPI.begin();
 	SPI.setDataMode(SPI_MODE0);
 	// Both SCI and SDI read data MSB first
 	SPI.setBitOrder(MSBFIRST);
 	// From the datasheet, max SPI reads are CLKI/6. Here CLKI = 26MHz -> SPI max speed is 4.33MHz.
-	// We'll take 16MHz/4 = 4MHz to be safe.
-	// Plus it's the max recommended speed when using a resistor-based lvl converter with an SD card.
+	// We'll take 16MHz/4 = 4MHz to be safe. csLow() and dcsLow() set it again after the SD card
+	// (see VS_SPI_SETTINGS), the card may run faster.
 	SPI.setClockDivider(SPI_CLOCK_DIV4);
 	SPI.transfer(0xFF);
 	delay(10);
@@ -81,7 +130,7 @@ bool Tune::begin()
 	delay(5);
 	
 	// Wait until the chip is ready
-	while (!digitalRead(DREQ));
+	while (!dreqPin.read());
 	delay(100);
 	
 	// Set playState flag
@@ -102,7 +151,7 @@ unsigned int Tune::readSCI(byte registerAddress)
 {
 	byte hiByte, loByte;
 	
-	while (!digitalRead(DREQ)); // DREQ high <-> VS1011 available
+	while (!dreqPin.read()); // DREQ high <-> VS1011 available
 	csLow(); // Select control
   
 	SPI.transfer(VS_READ); // Read instruction
@@ -110,9 +159,9 @@ unsigned int Tune::readSCI(byte registerAddress)
 	
 	// MSB first
 	hiByte = SPI.transfer(0x00); 
-	while (!digitalRead(DREQ)); // wait 'til cmd is complete
+	while (!dreqPin.read()); // wait 'til cmd is complete
 	loByte = SPI.transfer(0x00);
-	while (!digitalRead(DREQ));
+	while (!dreqPin.read());
 
 	csHigh(); // Deselect control
   
@@ -126,7 +175,7 @@ unsigned int Tune::readSCI(byte registerAddress)
 
 void Tune::writeSCI(byte registerAddress, byte highbyte, byte lowbyte)
 {
-	while (!digitalRead(DREQ)); // DREQ high <-> VS1011 available
+	while (!dreqPin.read()); // DREQ high <-> VS1011 available
 	csLow(); // Select control
 
 	SPI.transfer(VS_WRITE); // Write instruction
@@ -134,9 +183,9 @@ void Tune::writeSCI(byte registerAddress, byte highbyte, byte lowbyte)
 	
 	// MSB first
 	SPI.transfer(highbyte); 
-	while (!digitalRead(DREQ)); // wait 'til cmd is complete
+	while (!dreqPin.read()); // wait 'til cmd is complete
 	SPI.transfer(lowbyte);
-	while (!digitalRead(DREQ));
+	while (!dreqPin.read());
 	
 	csHigh(); // Deselect control
 }
@@ -158,7 +207,7 @@ void Tune::writeSCI(byte registerAddress, unsigned int data)
 
 void Tune::writeSDI(byte data)
 {
-	while (!digitalRead(DREQ)); // DREQ high <-> VS1011 available
+	while (!dreqPin.read()); // DREQ high <-> VS1011 available
 	dcsLow(); // Select data control
 
 	SPI.transfer(data);
@@ -318,6 +367,29 @@ int Tune::play(char* trackName)
 {
 	if (isPlaying()) return 1;
 	
+	// Already waiting in the cue buffer, just start it
+	if (cued && !strcasecmp(trackName, cueName)) return playCued();
+	
+	// Keep our position in the tracklist for playNext() & playPrev()
+	currentTrack = findTrack(trackName);
+	if (shuffle) syncShuffle();
+	return startTrack(trackName);
+}
+
+/** 
+	Opens a track and starts feeding it to the codec
+	Used by play() and by the track browsing methods, which already know the track index
+*/
+
+int Tune::startTrack(char* trackName)
+{
+	// Drop any cued track, it uses the same file
+	if (cued)
+	{
+		cued = 0;
+		track.close();
+	}
+	
 	// Exit if track not found
 	if (!track.open(trackName, O_READ))
 	{
@@ -325,13 +397,21 @@ int Tune::play(char* trackName)
 		return 3;
 	}
 	
+	// Skip tags or headers, exit if it's not a format we can play
+	if (!prepareTrack(trackName))
+	{
+		track.close();
+		return 4;
+	}
+	
 	playState = playback;
+	endOfTrack = 0;
 	
 	// Reset decode time & bitrate from previous playback
 	writeSCI(SCI_DECODE_TIME, 0);
 	delay(100);
 	
-	skipTag(); // Skip ID3v2 tag if there's one
+	checkContiguous(); // Stream it block by block if we can
 	
 	feed(); // Feed VS1011e
 	attachInterrupt(0, feed, RISING); // Let the interrupt handle the rest of the process
@@ -339,6 +419,244 @@ int Tune::play(char* trackName)
 	return 0;
 }
 
+/** 
+	Gets a track ready to be played : opens it, skips its tag and loads its first bytes in RAM
+	The following play() or playCued() then starts the sound right away, without waiting for the SD
+	Returns 0 if the track is cued, 1 if a track is playing, 3 if the track isn't found
+	and 4 if it's not a format we can play
+*/
+
+int Tune::cue(char* trackName)
+{
+	if (isPlaying()) return 1;
+	
+	// Replace a previous cue
+	if (cued)
+	{
+		cued = 0;
+		track.close();
+	}
+	
+	if (!track.open(trackName, O_READ)) return 3;
+	
+	// Skip tags or headers, exit if it's not a format we can play
+	if (!prepareTrack(trackName))
+	{
+		track.close();
+		return 4;
+	}
+	
+	// Prebuffer the beginning of the track, after the WAV header if there's one
+	uint32_t left = trackEnd - track.curPosition();
+	unsigned int size = sizeof(cueBuffer) - cueLength;
+	if (size > left) size = left;
+	int n = track.read(cueBuffer + cueLength, size);
+	if (n > 0) cueLength += n;
+	checkContiguous(); // Streaming will take over from there
+	
+	// Reset decode time & bitrate from previous playback now, not when the track is started
+	writeSCI(SCI_DECODE_TIME, 0);
+	delay(100);
+	
+	strncpy(cueName, trackName, sizeof(cueName) - 1);
+	cueName[sizeof(cueName) - 1] = 0;
+	cueTrack = findTrack(trackName);
+	cued = 1;
+	
+	return 0;
+}
+
+/** 
+	Starts the track prepared by cue()
+	Returns 0 if playback started, 1 if a track is playing and 2 if nothing is cued
+*/
+
+int Tune::playCued()
+{
+	if (isPlaying()) return 1;
+	if (!cued) return 2;
+	
+	cued = 0;
+	currentTrack = cueTrack;
+	if (shuffle) syncShuffle();
+	playState = playback;
+	endOfTrack = 0;
+	
+	feed(); // Feed VS1011e, from the cue buffer first
+	attachInterrupt(0, feed, RISING); // Let the interrupt handle the rest of the process
+	
+	return 0;
+}
+
+/** 
+	Rewrites a track as a contiguous file, so it can be streamed without any FAT lookup
+	Needs as much free space as the track size, and the track must not be playing
+	Returns 0 on success (or if the track already is contiguous), 1 if busy, 3 if not found, 4 on error
+*/
+
+int Tune::makeContiguous(char* trackName)
+{
+	if (isPlaying() || cued) return 1;
+	
+	if (!track.open(trackName, O_READ)) return 3;
+	
+	uint32_t bgnBlock, endBlock;
+	if (track.contiguousRange(&bgnBlock, &endBlock))
+	{
+		track.close();
+		return 0; // nothing to do
+	}
+	
+	// Allocate the copy in one piece
+	SdFile copy;
+	sd.remove(CONTIGUOUS_TMP); // leftover from an interrupted copy
+	if (!copy.createContiguous(sd.vwd(), CONTIGUOUS_TMP, track.fileSize()) || !copy.contiguousRange(&bgnBlock, &endBlock))
+	{
+		track.close();
+		if (copy.isOpen()) copy.remove();
+		return 4;
+	}
+	
+	// The cue buffer is free, nothing's cued : the copy goes through it
+#if CUE_BUFFER_SIZE >= 512
+	// Copy block by block, written straight to the card : the SdFat cache must not keep
+	// an old copy of these blocks, dirty ones are written first and all are dropped after
+	uint32_t position = 0;
+	bool ok = sd.vol()->cacheClear() != 0;
+	
+	for (uint32_t b = bgnBlock; ok && position < track.fileSize(); b++, position += 512)
+	{
+		ok = track.read(cueBuffer, 512) > 0 && sd.card()->writeBlock(b, cueBuffer);
+	}
+	sd.vol()->cacheInvalidate(bgnBlock, endBlock - bgnBlock + 1);
+#else
+	// Not enough RAM for a whole block : write the copy through the file
+	int n;
+	bool ok = true;
+	
+	while (ok && (n = track.read(cueBuffer, sizeof(cueBuffer))) > 0)
+	{
+		ok = copy.write(cueBuffer, n) == n;
+	}
+	ok = ok && n == 0 && copy.sync();
+#endif
+	track.close();
+	
+	if (!ok)
+	{
+		copy.remove();
+		return 4;
+	}
+	
+	// Swap the copy in place of the original
+	ok = sd.remove(trackName) && copy.rename(sd.vwd(), trackName);
+	copy.close();
+	return ok ? 0 : 4;
+}
+
+/** 
+	Registers a clip : length bytes of a file from the working directory, from position start
+	A length of 0 means up to the end of the file. Several clips can come from the same file.
+	The first bytes are loaded in RAM so playClip() is heard right away
+	Returns the clip number, or -1 if the file isn't found, there's no room left or a clip is playing
+*/
+
+int Tune::addClip(char* fileName, uint32_t start, uint32_t length)
+{
+	int clipNo;
+	for (clipNo=0; clipNo<MAX_CLIPS; clipNo++)
+	{
+		if (!clips[clipNo].pinned) break;
+	}
+	if (clipNo == MAX_CLIPS || clipActive) return -1;
+	
+	// Don't read the card behind the back of feed()
+	bool wasPlaying = (playState == playback);
+	pauseMusic();
+	
+	SdFile file;
+	clip_t* c = &clips[clipNo];
+	if (file.open(fileName, O_READ) && start < file.fileSize())
+	{
+		if (length == 0 || length > file.fileSize() - start) length = file.fileSize() - start;
+		
+		c->dirCluster = file.dirCluster();
+		c->dirIndex = file.dirIndex();
+		c->start = start;
+		c->length = length;
+		c->pinnedLength = length < CLIP_PIN_SIZE ? length : CLIP_PIN_SIZE;
+		c->pinned = (byte*) malloc(c->pinnedLength);
+		
+		if (c->pinned && (!file.seekSet(start) || file.read(c->pinned, c->pinnedLength) != (int) c->pinnedLength))
+		{
+			free(c->pinned);
+			c->pinned = 0;
+		}
+	}
+	file.close();
+	
+	if (wasPlaying) resumeMusic();
+	
+	return c->pinned ? clipNo : -1;
+}
+
+/** 
+	Plays a clip registered with addClip(), cutting the current track or clip
+	The track, if it was playing, goes on where it stopped once the clip is over
+	Returns 0 if the clip started, 2 if there's no such clip
+*/
+
+int Tune::playClip(byte clipNo)
+{
+	if (clipNo >= MAX_CLIPS || !clips[clipNo].pinned) return 2;
+	
+	// Take over the codec
+	detachInterrupt(0);
+	endStream();
+	clipFile.close(); // a clip cuts the previous one
+	flushCodec();
+	zeroRemain = 0;
+	
+	clip = &clips[clipNo];
+	clipIndex = 0;
+	clipRemain = clip->length;
+	clipActive = 1;
+	
+	feed(); // The pinned bytes go out right away
+	
+	// Open the rest of the clip while the codec plays them
+	if (clipActive && clipRemain > clip->pinnedLength - clipIndex)
+	{
+		if (!clipFile.open(sd.vol(), clip->dirCluster, clip->dirIndex, O_READ) || !clipFile.seekSet(clip->start + clip->pinnedLength))
+		{
+			clipFile.close();
+			clipRemain = clip->pinnedLength - clipIndex; // play what we have
+		}
+	}
+	
+	if (clipActive || playState == playback)
+	{
+		attachInterrupt(0, feed, RISING); // Let the interrupt handle the rest of the process
+		feed();
+	}
+	return 0;
+}
+
+/** 
+	Forgets a clip and frees its RAM
+	Returns 0 if done, 1 if the clip is playing, 2 if there's no such clip
+*/
+
+int Tune::removeClip(byte clipNo)
+{
+	if (clipNo >= MAX_CLIPS || !clips[clipNo].pinned) return 2;
+	if (clipActive && clip == &clips[clipNo]) return 1;
+	
+	free(clips[clipNo].pinned);
+	clips[clipNo].pinned = 0;
+	return 0;
+}
+
 /** 
 	Plays a track with the name formatted as "trackXXX.mp3"
 	Where "XXX" is a number between 0 and 999.
@@ -372,71 +690,134 @@ void Tune::playPlaylist(int start, int end)
 }
 
 /** 
-	Stops current track and plays next available track
-	Loops around if it reaches the end of the tracklist
+	Stops current track and plays next available track, in tracklist or shuffle order
+	Loops around if it reaches the end of the tracklist, unless repeat is off
 */
 
 void Tune::playNext()
 {
-	char filename[13] = "";
-	int charCount = 0;
-	int i;
+	if (nb_track == 0) return;
 	
-	track.getName(filename, 13); // get current filename
-		
-	for (i=0; i<=nb_track; i++) // look in the tracklist
+	if (shuffle)
 	{
-		for (int j=0; j<13; j++)
+		unsigned int pos = shufflePos + 1;
+		if (pos == nb_track) pos = 0;
+		
+		if (currentTrack >= nb_track) pos = shuffleStart; // nothing played yet, the cycle starts here
+		else if (pos == shuffleStart) // every track has been played once
 		{
-			if (filename[j] == tracklist[i][j]) charCount++;
-			else break;  // move on if a single character differs
+			if (repeatMode == REPEAT_OFF) return;
+			newShuffle(); // draw another order for the next cycle
+			// Don't start it with the track that ended the last one, it then ends the new cycle
+			if (nb_track > 1 && shuffleTrack(0) == currentTrack) pos = 1;
+			else pos = 0;
+			shuffleStart = pos;
 		}
-		if (charCount == 13) break; // found current track in the list, exit loop
-		else charCount = 0; // reset for next turn
+		shufflePos = pos;
+		currentTrack = shuffleTrack(pos);
+	}
+	else
+	{
+		if (currentTrack < nb_track-1) currentTrack++; // next track
+		else if (currentTrack == nb_track-1 && repeatMode == REPEAT_OFF) return;
+		else currentTrack = 0; // wrap around
 	}
 	stopTrack(); // stop current track
-	
-	if (i < nb_track-1) i++; // search for next track
-	else i = 0; // wrap around
-	
-	for (int j=0; j<13; j++)
-		filename[j] = tracklist[i][j];
-
-	play(filename); // and play said file
+	startTrack(tracklist[currentTrack]); // and play the new one
 }
 
 /** 
-	Stops current track and plays previous available track
-	Loops around if it reaches the beginning of the tracklist
+	Stops current track and plays previous available track, in tracklist or shuffle order
+	Loops around if it reaches the beginning of the tracklist, unless repeat is off
 */
 
 void Tune::playPrev()
 {
-	char filename[13] = "";
-	int charCount = 0;
-	int i;
+	if (nb_track == 0) return;
 	
-	track.getName(filename, 13); // get current filename
-		
-	for (i=0; i<=nb_track; i++) // look in the tracklist
+	if (shuffle)
 	{
-		for (int j=0; j<13; j++)
+		if (shufflePos != shuffleStart) // go back in the current cycle
+		{
+			if (shufflePos > 0) shufflePos--;
+			else shufflePos = nb_track-1;
+		}
+		else if (repeatMode != REPEAT_OFF) // wrap around to the end of the cycle
 		{
-			if (filename[j] == tracklist[i][j]) charCount++;
-			else break; // move on if a single character differs
+			if (shuffleStart > 0) shufflePos = shuffleStart-1;
+			else shufflePos = nb_track-1;
 		}
-		if (charCount == 13) break; // found current track in the list, exit loop
-		else charCount = 0; // reset for next turn
+		currentTrack = shuffleTrack(shufflePos);
+	}
+	else
+	{
+		if (currentTrack > 0 && currentTrack < nb_track) currentTrack--; // previous track
+		else if (currentTrack == 0 && repeatMode == REPEAT_OFF) currentTrack = 0; // start over
+		else currentTrack = nb_track-1; // wrap around
 	}
 	stopTrack(); // stop current track
+	startTrack(tracklist[currentTrack]); // and play the new one
+}
+
+/**
+	Turns shuffle on or off
+	A shuffle cycle plays every track of the tracklist exactly once, starting with the current one,
+	without storing the order : it's computed on the fly so any number of tracks fits in RAM
+*/
+
+void Tune::setShuffle(bool enable)
+{
+	if (enable && !shuffle)
+	{
+		newShuffle();
+		syncShuffle();
+	}
+	shuffle = enable;
+}
+
+/**
+	Starts the shuffle cycle on the current track so it won't come back before the others
+	Used when shuffle is turned on and when a track is picked by play()
+*/
+
+void Tune::syncShuffle()
+{
+	if (currentTrack < nb_track) shufflePos = shufflePosition(currentTrack);
+	else shufflePos = 0;
+	shuffleStart = shufflePos;
+}
+
+/**
+	Sets what happens at the end of a track : REPEAT_OFF, REPEAT_ONE or REPEAT_ALL (default)
+	With REPEAT_OFF, playback stops after the last track (or the end of the shuffle cycle)
+*/
+
+void Tune::setRepeat(byte mode)
+{
+	repeatMode = mode;
+}
+
+/**
+	Chains tracks according to the shuffle & repeat settings
+	Call it from loop() : when the current track has ended, it starts the next one
+	It also keeps the slower SCK rate the card fell back to after read errors
+*/
+
+void Tune::update()
+{
+#if SD_AUTO_SPEED
+	byte divisor = sd.card()->sckDivisor();
+	if (divisor != eeprom_read_byte((uint8_t*)SD_SPEED_EEPROM)) saveSdSpeed(divisor);
+#endif
 	
-	if (i > 0) i--; // search for next track
-	else i = nb_track-1; // wrap around
-	
-	for (int j=0; j<13; j++)
-		filename[j] = tracklist[i][j];
+	if (!endOfTrack) return;
+	endOfTrack = 0;
 	
-	play(filename); // and play said file
+	if (repeatMode == REPEAT_ONE)
+	{
+		if (currentTrack < nb_track) startTrack(tracklist[currentTrack]);
+	}
+	else playNext();
 }
 
 /**
@@ -520,6 +901,7 @@ void Tune::pauseMusic()
 	if (playState == playback)
 	{
 		detachInterrupt(0);
+		endStream(); // Free the SD card for other reads
 		playState = pause;
 	}
 }
@@ -543,14 +925,22 @@ void Tune::resumeMusic()
 
 bool Tune::stopTrack()
 {
+	if (cued) // Drop a cued track that wasn't started
+	{
+		cued = 0;
+		return track.close();
+	}
+	
 	if (!isPlaying()) return 0; // Skip if not already playing
 	
 	detachInterrupt(0);
+	endStream();
 	playState = idle;
 	
 	if (!track.close()) return 0; // close track
 	
-	sendZeros(); // clear codec's buffer
+	if (clipActive) attachInterrupt(0, feed, RISING); // let a clip end
+	else sendZeros(); // clear codec's buffer
 	return 1;
 }
 
@@ -561,9 +951,10 @@ bool Tune::stopTrack()
 void Tune::csLow()
 {
 	// Make sure the other CSs are high before activating SCI
-	digitalWrite(SDCS, HIGH);
-	digitalWrite(XDCS, HIGH);
-	digitalWrite(XCS, LOW);
+	sdcsPin.high();
+	xdcsPin.high();
+	SPI.beginTransaction(VS_SPI_SETTINGS);
+	xcsPin.low();
 }
 
 /** 
@@ -572,7 +963,8 @@ void Tune::csLow()
 
 void Tune::csHigh()
 {
-	digitalWrite(XCS, HIGH);
+	xcsPin.high();
+	SPI.endTransaction();
 }
 
 /** 
@@ -582,9 +974,10 @@ void Tune::csHigh()
 void Tune::dcsLow()
 {
 	// Make sure the other CSs are high before activating SDI
-	digitalWrite(SDCS, HIGH);
-	digitalWrite(XCS, HIGH);
-	digitalWrite(XDCS, LOW);
+	sdcsPin.high();
+	xcsPin.high();
+	SPI.beginTransaction(VS_SPI_SETTINGS);
+	xdcsPin.low();
 }
 
 /** 
@@ -593,7 +986,8 @@ void Tune::dcsLow()
 
 void Tune::dcsHigh()
 {
-	digitalWrite(XDCS, HIGH);
+	xdcsPin.high();
+	SPI.endTransaction();
 }
 
 /** 
@@ -603,94 +997,343 @@ void Tune::dcsHigh()
 
 int Tune::listFiles()
 {
+	dirInfo_t info[4]; // entries decoded per call, from the cached block
+	int n;
 	nb_track = 0;
-	char filename[13] = "";
-	char firstfilename[13] = "";
-	
-	// Save the name of the first file to rewind the directory later
-	track.openNext(sd.vwd(), O_READ);
-	track.getName(firstfilename, 13);
-	if (isMP3(firstfilename)) nb_track++;
-	track.close();
 	
-	// open next file in root.  The volume working directory, vwd, is root
-	while (track.openNext(sd.vwd(), O_READ)) 
+	// count the playable files of the volume working directory, root
+	sd.vwd()->rewind();
+	while ((n = sd.vwd()->readDir(info, 4)) > 0)
 	{
-		track.getName(filename, 13);
-		if (isMP3(filename)) nb_track++;
-		track.close();
+		for (int k=0; k<n; k++)
+		{
+			if (isPlayable(info[k].name)) nb_track++;
+		}
 	}
 	
 	// now that we know how many available tracks we have
 	// we can itinialize the 2D-array with the correct dimensions
 	tracklist = (char**) malloc (nb_track*sizeof(char*));
-	for (int k=0; k<nb_track; k++)
+	for (unsigned int k=0; k<nb_track; k++)
 	{
 		tracklist[k] = (char*) malloc(13 * sizeof(char));
 	}
 	
 	nb_track = 0; // reset for rerun
 
-	// rewind for first run then loop again
-	track.open(firstfilename);
-	track.getName(filename, 13);
-	
-	if (isMP3(filename)) 
+	// rewind and loop again to save the names
+	sd.vwd()->rewind();
+	while ((n = sd.vwd()->readDir(info, 4)) > 0)
 	{
-		for (int j=0; j<13; j++)
+		for (int k=0; k<n; k++)
 		{
-			tracklist[nb_track][j] = filename[j]; // actually save the filename
+			if (isPlayable(info[k].name)) 
+			{
+				size_t len = min(strlen(info[k].name), (size_t)12); // cut like getName(name, 13)
+				memcpy(tracklist[nb_track], info[k].name, len);
+				tracklist[nb_track][len] = 0;
+				nb_track++;
+			}
 		}
-		nb_track++;
 	}
-	track.close();
+	return nb_track;
+}
+
+/** 
+	Checks if the file is something the codec can play
+*/
+
+bool Tune::isPlayable(char* filename)
+{
+	return isMP3(filename) || isWAV(filename);
+}
+
+/** 
+	Checks if the file is an .mp3
+*/
+
+bool Tune::isMP3(char* filename)
+{
+	char* extension = strrchr(filename, '.');
+	return extension && !strcasecmp(extension, ".mp3");
+}
+
+/** 
+	Checks if the file is a .wav
+*/
+
+bool Tune::isWAV(char* filename)
+{
+	char* extension = strrchr(filename, '.');
+	return extension && !strcasecmp(extension, ".wav");
+}
+
+/** 
+	Looks for a track in the tracklist
+	Returns its index, or the number of tracks if it isn't listed
+*/
+
+unsigned int Tune::findTrack(char* trackName)
+{
+	unsigned int i;
+	
+	for (i=0; i<nb_track; i++)
+	{
+		if (!strcasecmp(trackName, tracklist[i])) break;
+	}
+	return i;
+}
+
+/** 
+	Draws a new shuffle order
+	The order is a permutation of [0, nb_track) picked by a 32 bit key : two odd multiplications
+	and a xorshift, all reversible modulo the power of two covering nb_track
+*/
+
+void Tune::newShuffle()
+{
+	shuffleKey = micros() ^ (shuffleKey * 69069UL + 1); // user timing makes a good seed
+	
+	shuffleMask = 0;
+	if (nb_track > 1)
+	{
+		while (shuffleMask < nb_track-1) shuffleMask = (shuffleMask << 1) | 1;
+	}
+}
+
+/** 
+	Returns the track played at a given position of the shuffle cycle
+	Out of range values are walked through the permutation again until they fall in the tracklist,
+	which keeps it a permutation of the tracks - takes less than 2 rounds on average
+*/
+
+unsigned int Tune::shuffleTrack(unsigned int pos)
+{
+	unsigned int a = (unsigned int) shuffleKey | 1;
+	unsigned int b = (unsigned int) (shuffleKey >> 16) | 1;
+	unsigned int c = (unsigned int) (shuffleKey >> 8);
+	byte shift = 1;
+	
+	// About half the width of the mask, in a long : a 16 bit mask would be shifted by 16
+	while (((unsigned long) shuffleMask >> (2 * shift)) != 0) shift++;
+	
+	do
+	{
+		pos = (pos * a + c) & shuffleMask;
+		pos ^= pos >> shift;
+		pos = (pos * b + c) & shuffleMask;
+	} while (pos >= nb_track);
 	
-	// save as above...
-	while (track.openNext(sd.vwd(), O_READ))
+	return pos;
+}
+
+/** 
+	Returns the position of a track in the shuffle cycle, i.e. the inverse of shuffleTrack()
+*/
+
+unsigned int Tune::shufflePosition(unsigned int trackNo)
+{
+	unsigned int a = (unsigned int) shuffleKey | 1;
+	unsigned int b = (unsigned int) (shuffleKey >> 16) | 1;
+	unsigned int c = (unsigned int) (shuffleKey >> 8);
+	byte shift = 1;
+	
+	while (((unsigned long) shuffleMask >> (2 * shift)) != 0) shift++;
+	
+	// Inverses of the odd multipliers (Newton's iteration, each step doubles the number of valid bits)
+	unsigned int aInv = a;
+	unsigned int bInv = b;
+	for (byte i=0; i<4; i++)
+	{
+		aInv *= 2 - a * aInv;
+		bInv *= 2 - b * bInv;
+	}
+	
+	do
 	{
-		track.getName(filename, 13);
+		trackNo = ((trackNo - c) * bInv) & shuffleMask;
+		for (unsigned int t = trackNo >> shift; t != 0; t >>= shift) trackNo ^= t;
+		trackNo = ((trackNo - c) * aInv) & shuffleMask;
+	} while (trackNo >= nb_track);
+	
+	return trackNo;
+}
+
+/** 
+	Returns the number of playable tracks on the SD card
+*/
+
+unsigned int Tune::getNbTracks()
+{
+	return nb_track;
+}
+
+/** 
+	Gets the open track ready to be fed : skips the ID3v2 tag of an MP3 or parses the header of a WAV
+	Returns 0 if it's not a format the codec can play
+*/
+
+bool Tune::prepareTrack(char* trackName)
+{
+	cueLength = 0;
+	cueIndex = 0;
+	trackEnd = track.fileSize();
+	byteRate = 0;
+	wavHeader = 0;
+	headerRemain = 0;
+	zeroRemain = 0;
+	
+	if (isWAV(trackName)) return parseWAV();
+	
+	skipTag(); // Skip ID3v2 tag if there's one
+	return 1;
+}
+
+/** 
+	Reads the RIFF header of a WAV track and moves to the start of its data chunk
+	The codec still needs the format, so a compact header (fmt chunk and data chunk size) is
+	rebuilt in the cue buffer : feed() sends it first, and other chunks are never read
+	Only PCM & IMA ADPCM are decoded by the VS1011e
+*/
+
+bool Tune::parseWAV()
+{
+	byte* header = cueBuffer;
+	byte chunk[8];
+	bool fmtFound = 0;
+	
+	track.seekSet(0);
+	if (track.read(header, 12) != 12 || memcmp(header, "RIFF", 4) || memcmp(header + 8, "WAVE", 4)) return 0;
+	cueLength = 12;
+	
+	while (1)
+	{
+		if (track.read(chunk, 8) != 8) return 0; // no data chunk
 		
-		if (isMP3(filename)) 
+		// chunk sizes are little endian
+		uint32_t size = ((uint32_t) chunk[7] << 24) | ((uint32_t) chunk[6] << 16) | ((uint32_t) chunk[5] << 8) | chunk[4];
+		
+		if (!memcmp(chunk, "fmt ", 4))
 		{
-			for (int j=0; j<13; j++)
-			{
-				tracklist[nb_track][j] = filename[j];
-			}
-			nb_track++;
+			if (size < 16 || size > 40) return 0;
+			
+			byte* fmt = header + cueLength + 8;
+			memcpy(header + cueLength, chunk, 8);
+			if (track.read(fmt, size) != (int) size) return 0;
+			if (size & 1) track.seekCur(1); // chunks are word aligned
+			
+			unsigned int format = word(fmt[1], fmt[0]);
+			if (format != 0x0001 && format != 0x0011) return 0; // PCM or IMA ADPCM
+			
+			byteRate = ((uint32_t) fmt[11] << 24) | ((uint32_t) fmt[10] << 16) | ((uint32_t) fmt[9] << 8) | fmt[8];
+			cueLength += 8 + size;
+			fmtFound = 1;
 		}
-		track.close();
+		else if (!memcmp(chunk, "data", 4))
+		{
+			if (!fmtFound) return 0;
+			
+			memcpy(header + cueLength, chunk, 8);
+			cueLength += 8;
+			
+			// Stop at the end of the samples, not at the end of the file
+			if (size < trackEnd - track.curPosition()) trackEnd = track.curPosition() + size;
+			break;
+		}
+		else if (!track.seekCur(size + (size & 1))) return 0; // skip this chunk
 	}
-	return nb_track;
+	
+	// Fix the RIFF size for the rebuilt file
+	uint32_t riffSize = cueLength - 8 + trackEnd - track.curPosition();
+	for (int i=0; i<4; i++) header[4 + i] = riffSize >> (8 * i);
+	wavHeader = cueLength;
+	
+	return 1;
 }
 
 /** 
-	Checks if the file is an .mp3
+	Returns how many bytes per second the current track needs, e.g. 176400 for a 44.1 kHz 16 bit
+	stereo WAV, as read in its header. Returns 0 for an MP3.
 */
 
-bool Tune::isMP3(char* filename)
+unsigned long Tune::getByteRate()
 {
-	for (int i=0; i<10; i++)
+	return byteRate;
+}
+
+/** 
+	Measures how many bytes per second can go from a track on the card to the codec's bus,
+	reading 8 KB the way feed() does. Compare with getByteRate() :
+	a 44.1 kHz 16 bit stereo WAV needs 176400 bytes/s. Returns 0 on error.
+*/
+
+unsigned long Tune::measureThroughput(char* trackName)
+{
+	if (isPlaying() || cued) return 0;
+	if (!track.open(trackName, O_READ)) return 0;
+	
+	unsigned long bytes = 0;
+	unsigned long time = micros();
+	
+	if (prepareTrack(trackName))
 	{
-		// search for file extension
-		if (filename[i] == '.')
+		checkContiguous();
+		while (bytes < 8192)
 		{
-			// and check it
-			if( (filename[i+1] == 'm' || 'M') && (filename[i+2] == 'p' || 'P') && (filename[i+3] == '3') ) return 1; // valid file !
-			else return 0;
+			byte* data = buffer;
+			int n;
+			
+			if (contiguous) n = readStream(&data);
+			else n = track.read(buffer, sizeof(buffer));
+			if (n <= 0) break;
+			
+			// Same bus traffic as feeding the codec, with no chip selected
+			SPI.beginTransaction(VS_SPI_SETTINGS);
+			SPI.transfer(data, NULL, n);
+			SPI.endTransaction();
+			bytes += n;
 		}
 	}
-	return 0;
+	time = micros() - time;
+	
+	endStream();
+	track.close();
+	cueLength = 0;
+	
+	// bytes * 1000000 / time, without overflowing
+	if (time < 64) return 0;
+	return bytes * 15625UL / (time / 64);
 }
 
 /** 
-	Searches for an ID3v2 tag and skips it so there's no delay for playback
+	Looks for the fastest SCK rate the SD card reads at without errors, starting from the
+	current one, and keeps it in EEPROM for begin(). begin() calls it the first time.
+	Not while a track plays. Returns the SCK divisor of the card, 0 if it can't be read
 */
 
-unsigned int Tune::getNbTracks()
+byte Tune::tuneSD()
 {
-	return nb_track;
+	if (isPlaying()) return 0;
+	
+	byte divisor = sd.card()->tuneSckDivisor();
+#if SD_AUTO_SPEED
+	if (divisor) saveSdSpeed(divisor);
+#endif
+	return divisor;
 }
 
+#if SD_AUTO_SPEED
+/** 
+	Keeps the SCK divisor of the card in EEPROM for begin(), with its complement to check it
+*/
+
+void Tune::saveSdSpeed(byte divisor)
+{
+	eeprom_update_byte((uint8_t*)SD_SPEED_EEPROM, divisor);
+	eeprom_update_byte((uint8_t*)SD_SPEED_EEPROM + 1, ~divisor);
+}
+#endif
+
 /** 
 	Searches for an ID3v2 tag and skips it so there's no delay for playback
 */
@@ -1006,16 +1649,108 @@ void Tune::findv23(char* infobuffer)
 void Tune::feed()
 {
 	sei();
-	while (digitalRead(DREQ))
+	while (1)
 	{
-		// Go out to SD card and try reading 32 new bytes of the track
-		if (!track.read(buffer, sizeof(buffer)))
+		if (!dreqPin.read())
+		{
+#if STREAM_AHEAD
+			// DREQ may rise while reading ahead : check it again
+			if (readAhead()) continue;
+#endif
+			break;
+		}
+		byte* data = buffer;
+		int n;
+		
+		if (clipActive)
+		{
+			// A clip has priority over the track
+			n = readClip(&data);
+			if (n < 0) break; // playClip() is still opening the file
+			
+			if (n == 0)
+			{
+				// Clip over, back to the interrupted track if there's one
+				clipFile.close();
+				clipActive = 0;
+				
+				// playClip() reset the codec : a WAV track, playing or paused, needs its header again
+				// Unless the cue buffer is still on it, then it's sent from the start
+				if ((playState == playback || playState == pause) && wavHeader)
+				{
+					if (cueIndex <= wavHeader) cueIndex = 0;
+					else headerRemain = wavHeader;
+				}
+				
+				if (playState != playback)
+				{
+					// End the clip's stream now, resumeMusic() goes on with the header
+					detachInterrupt(0);
+					sendZeros();
+					break;
+				}
+				
+				// The codec is decoding the clip's stream : end it before the header
+				if (wavHeader) zeroRemain = 2052;
+				continue;
+			}
+		}
+		else if (zeroRemain)
+		{
+			// End fill between two streams
+			n = zeroRemain > 32 ? 32 : zeroRemain;
+			memset(buffer, 0, n);
+			zeroRemain -= n;
+		}
+		else if (headerRemain)
+		{
+			// The WAV header again after a clip, then the cue buffer goes on where it was
+			data = cueBuffer + wavHeader - headerRemain;
+			n = headerRemain > 32 ? 32 : headerRemain;
+			headerRemain -= n;
+		}
+		else if (cueIndex < cueLength)
+		{
+			// Start with what cue() loaded in RAM
+			data = cueBuffer + cueIndex;
+			n = cueLength - cueIndex;
+			if (n > 32) n = 32;
+			cueIndex += n;
+		}
+		else if (contiguous)
+		{
+			// Get the next bytes of the multi-block read
+			n = readStream(&data);
+			
+			if (n < 0)
+			{
+				// Streaming failed, go on with regular reads from where we are
+				endStream();
+				contiguous = 0;
+				track.seekSet(trackEnd - streamRemain);
+				data = buffer;
+				n = track.read(buffer, streamRemain < sizeof(buffer) ? streamRemain : sizeof(buffer));
+			}
+		}
+		else
+		{
+			// Go out to SD card and try reading 32 new bytes of the track
+			// Reads stop on 32 byte boundaries, so they never straddle two blocks
+			uint32_t position = track.curPosition();
+			unsigned int size = sizeof(buffer) - (position & (sizeof(buffer) - 1));
+			if (size > trackEnd - position) size = trackEnd - position;
+			n = track.read(buffer, size);
+		}
+		
+		if (n <= 0)
 		{
 			// exit if end of file reached
+			endStream();
 			track.close();
 			detachInterrupt(0);
 			sendZeros();
 			playState = idle;
+			endOfTrack = 1; // let update() chain the next track
 			
 			break;
 		}
@@ -1023,15 +1758,158 @@ void Tune::feed()
 		dcsLow(); // Select data control
 		
 		// Feed the chip
-		for (int i=0; i<32; i++)
-		{
-			SPI.transfer(buffer[i]);
-		}
+		SPI.transfer(data, NULL, n);
 		dcsHigh(); // Deselect data control
 		sei();
 	}
 }
 
+#if STREAM_AHEAD
+/** 
+	Reads the next bytes of a contiguous track while the codec is busy with what it got
+	They go out as soon as DREQ rises. Returns 1 if bytes were read
+*/
+
+bool Tune::readAhead()
+{
+	if (playState != playback || !contiguous || clipActive || zeroRemain || headerRemain || cueIndex < cueLength || aheadLength) return 0;
+	
+	int n = readPart(streamAhead);
+	if (n > 0)
+	{
+		aheadLength = n;
+		return 1;
+	}
+	endStream(); // the next readStream() starts it again, or falls back to regular reads
+	return 0;
+}
+#endif
+
+/** 
+	Gets the next bytes of the current clip, from RAM first and then from its file
+	Returns how many bytes are available in *data, 0 at the end of the clip,
+	or -1 if the file isn't open yet
+*/
+
+int Tune::readClip(byte** data)
+{
+	if (clipRemain == 0) return 0;
+	
+	int n;
+	if (clipIndex < clip->pinnedLength)
+	{
+		*data = clip->pinned + clipIndex;
+		n = clip->pinnedLength - clipIndex;
+		if (n > 32) n = 32;
+		clipIndex += n;
+	}
+	else
+	{
+		if (!clipFile.isOpen()) return -1;
+		
+		*data = buffer;
+		n = clipFile.read(buffer, clipRemain < sizeof(buffer) ? clipRemain : sizeof(buffer));
+		if (n <= 0) return 0; // read error, end the clip here
+	}
+	clipRemain -= n;
+	return n;
+}
+
+/** 
+	Drops the data waiting in the codec, so the next stream is heard at once
+	The VS1011e can only do that with a software reset : settings are saved and restored around it
+*/
+
+void Tune::flushCodec()
+{
+	unsigned int volume = readSCI(SCI_VOL);
+	unsigned int bass = readSCI(SCI_BASS);
+	
+	setBit(SCI_MODE, SM_RESET);
+	setBit(SCI_MODE, SM_SDINEW);
+	writeSCI(SCI_CLOCKF, 0x32, 0xC8);
+	writeSCI(SCI_BASS, bass);
+	writeSCI(SCI_VOL, volume);
+}
+
+/** 
+	Checks if the open track is contiguous on the card
+	If so, feed() streams it with a multi-block read from the current position, bypassing the FAT
+*/
+
+void Tune::checkContiguous()
+{
+	uint32_t bgnBlock, endBlock;
+	
+#if STREAM_AHEAD
+	aheadLength = 0;
+#endif
+	contiguous = track.contiguousRange(&bgnBlock, &endBlock);
+	if (!contiguous) return;
+	
+	uint32_t position = track.curPosition();
+	streamBlock = bgnBlock + (position >> 9);
+	streamOffset = position & 511;
+	streamRemain = trackEnd - position;
+}
+
+/** 
+	Gets up to 32 bytes of a contiguous track, the ones read ahead first
+	Returns how many bytes are available in *data, 0 at the end of the track or -1 on error
+*/
+
+int Tune::readStream(byte** data)
+{
+#if STREAM_AHEAD
+	if (aheadLength)
+	{
+		int n = aheadLength;
+		aheadLength = 0;
+		*data = streamAhead;
+		return n;
+	}
+#endif
+	*data = buffer;
+	return readPart(buffer);
+}
+
+/** 
+	Reads up to 32 bytes of a contiguous track from the card, without going past a block
+	The card is only selected during the read : the bus is free for the codec between two parts of a block
+	Returns how many bytes were read in dst, 0 at the end of the track or -1 on error
+*/
+
+int Tune::readPart(byte* dst)
+{
+	if (streamRemain == 0) return 0;
+	
+	unsigned int n = 512 - streamOffset;
+	if (n > 32) n = 32;
+	if (n > streamRemain) n = streamRemain;
+	
+	// The card goes on with the multi-block read, or starts it again from the current position :
+	// after play(), a pause, or any other card access, which ends it first
+	if (!sd.card()->readStreamPart(streamBlock, streamOffset, dst, n)) return -1;
+	
+	streamOffset += n;
+	streamRemain -= n;
+	if (streamOffset == 512) // move on to the next block
+	{
+		streamBlock++;
+		streamOffset = 0;
+	}
+	return n;
+}
+
+/** 
+	Ends the multi-block read, if any, so the card accepts other commands
+*/
+
+void Tune::endStream()
+{
+	sd.card()->readStreamStop();
+}
+
 /** 
 	Sends zeros to the codec to make sure nothing's left unplayed
 */
@@ -1041,7 +1919,7 @@ void Tune::sendZeros()
 	dcsLow(); // Select data control
 	for (int i=0; i<2052; i++)
 	{
-		while (!digitalRead(DREQ)); // wait until chip is ready
+		while (!dreqPin.read()); // wait until chip is ready
 		SPI.transfer(0); 			// send zero	
 	}
 	dcsHigh(); // Deselect data control
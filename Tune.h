@@ -190,6 +190,69 @@ static unsigned int playState;
 #define playback	1
 #define pause		2
 
+/* Repeat modes */
+
+#define REPEAT_OFF	0
+#define REPEAT_ONE	1
+#define REPEAT_ALL	2
+
+/* Cue buffer : first bytes of a cued track, kept in RAM so playback starts without reading the SD */
+
+#if defined(RAMEND) && RAMEND < 3000
+#define CUE_BUFFER_SIZE 256
+#else
+#define CUE_BUFFER_SIZE 512
+#endif
+
+/* Sound clips : parts of files played over the current track, their first bytes pinned in RAM */
+
+#define MAX_CLIPS 8
+#if defined(RAMEND) && RAMEND < 3000
+#define CLIP_PIN_SIZE 128
+#else
+#define CLIP_PIN_SIZE 512
+#endif
+
+/* Streaming : contiguous tracks are read 32 bytes at a time, between two bursts to the codec.
+   With enough RAM the next 32 bytes are read ahead, while the codec has no room for them */
+
+#if defined(RAMEND) && RAMEND < 3000
+#define STREAM_AHEAD 0
+#else
+#define STREAM_AHEAD 1
+#endif
+
+/* makeContiguous() copies a track to this file of the working directory first.
+   The name is reserved for Tune : a file left by that name is deleted */
+
+#define CONTIGUOUS_TMP "~TUNE.TMP"
+
+/* SD card SCK rate : begin() looks for the fastest rate the card reads at without errors
+   and keeps it in EEPROM, at SD_SPEED_EEPROM, for the next runs. A read with CRC or token errors
+   slows the card down, update() then keeps the slower rate. Needs the EEPROM of an AVR (the host
+   core has one too), elsewhere it's 0 : the card runs at SPI_HALF_SPEED */
+
+#if (defined(__AVR__) || defined(ARDUINO_ARCH_HOST)) && defined(E2END)
+#define SD_AUTO_SPEED 1
+#define SD_SPEED_EEPROM (E2END - 1) // divisor, then its complement
+#else
+#define SD_AUTO_SPEED 0
+#endif
+
+/* The codec gets its own SCK rate, whatever the card's : max SPI reads are CLKI/6 = 4.33MHz */
+
+#define VS_SPI_SETTINGS SPISettings(4000000, MSBFIRST, SPI_MODE0)
+
+typedef struct
+{
+	uint32_t dirCluster;       // directory of the file, and its entry there : the file is reopened
+	uint16_t dirIndex;         // quickly, whatever the working directory
+	uint32_t start;            // position of the clip in the file
+	uint32_t length;           // clip length in bytes
+	byte* pinned;              // first bytes of the clip
+	unsigned int pinnedLength;
+} clip_t;
+
 /* ID3v1 tag offsets */
 
 #define TITLE   0
@@ -226,9 +289,21 @@ class Tune
 		void clearBit(byte regAddress, unsigned int bitAddress);
 		int play(char* trackName);
 		int playTrack(unsigned int trackNo);
+		int cue(char* trackName);
+		int playCued();
+		int makeContiguous(char* trackName);
+		int addClip(char* fileName, uint32_t start = 0, uint32_t length = 0);
+		int playClip(byte clipNo);
+		int removeClip(byte clipNo);
+		unsigned long getByteRate();
+		unsigned long measureThroughput(char* trackName);
+		byte tuneSD();
 		void playPlaylist(int start, int end);
 		void playNext();
 		void playPrev();
+		void setShuffle(bool enable);
+		void setRepeat(byte mode);
+		void update();
 		unsigned int getNbTracks();
 		int isPlaying();
 		int getState();
@@ -249,8 +324,63 @@ class Tune
 		static void dcsLow();
 		static void dcsHigh();
 		char** tracklist;
+		unsigned int currentTrack;
+		bool shuffle;
+		byte repeatMode;
+		unsigned long shuffleKey;
+		unsigned int shuffleMask;
+		unsigned int shufflePos;
+		unsigned int shuffleStart;
+		static volatile bool endOfTrack;
+		bool cued;
+		unsigned int cueTrack;
+		char cueName[13];
+		static byte cueBuffer[CUE_BUFFER_SIZE];
+		static unsigned int cueLength;
+		static unsigned int cueIndex;
+		static bool contiguous;
+#if STREAM_AHEAD
+		static byte streamAhead[32];
+		static unsigned int aheadLength;
+#endif
+		static uint32_t streamBlock;
+		static unsigned int streamOffset;
+		static uint32_t streamRemain;
+		clip_t clips[MAX_CLIPS];
+		static clip_t* clip;
+		static SdFile clipFile;
+		static volatile bool clipActive;
+		static unsigned int clipIndex;
+		static uint32_t clipRemain;
+		static int readClip(byte** data);
+		void flushCodec();
+		static void checkContiguous();
+		static int readStream(byte** data);
+		static int readPart(byte* dst);
+#if STREAM_AHEAD
+		static bool readAhead();
+#endif
+		static void endStream();
+		int startTrack(char* trackName);
+		bool prepareTrack(char* trackName);
+		bool parseWAV();
+		unsigned long byteRate;
+		static uint32_t trackEnd;
+		static unsigned int wavHeader;
+		static unsigned int headerRemain;
+		static unsigned int zeroRemain;
+		unsigned int findTrack(char* trackName);
+#if SD_AUTO_SPEED
+		void saveSdSpeed(byte divisor);
+#endif
+		void newShuffle();
+		void syncShuffle();
+		unsigned int shuffleTrack(unsigned int pos);
+		unsigned int shufflePosition(unsigned int trackNo);
 		int listFiles();
+		bool isPlayable(char* filename);
 		bool isMP3(char* filename);
+		bool isWAV(char* filename);
 		void skipTag();
 		int getID3v1(unsigned char offset, char* infobuffer);
 		int getID3v1Title(char* infobuffer);
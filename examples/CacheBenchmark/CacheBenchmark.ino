@@ -0,0 +1,184 @@
+/*
+ * Cache benchmark for Tune shield by Snootlab
+ * Copyleft Snootlab 2015
+ *
+ * Circuit : Arduino Uno/Mega, Tune shield with an SD card
+ * Code : replays the SD card accesses the volume cache sees most,
+ *  a directory scan, file opens by name, a track read while a log
+ *  file is appended to and a logger writing short records. Prints for
+ *  each one the blocks found in the cache, the hit rate, the blocks
+ *  read from the card and the blocks and commands written to it.
+ *  Needs CACHE_STATS set to 1 in SdFatConfig.h, the cache holds
+ *  CACHE_BLOCK_COUNT blocks. Creates a BENCH folder of small files
+ *  and a 64 KB track on the card at the first run.
+ */
+
+// Libraries needed
+#include <Tune.h>
+#include <SdFat.h>
+#include <SPI.h>
+
+#if !CACHE_STATS
+#error Set CACHE_STATS to 1 in SdFatConfig.h
+#endif
+
+// Object declaration
+Tune player;
+
+// Files in the BENCH folder, 16 fit in a directory block
+const int files = 48;
+// Track read while the log grows, and its size
+const char trackName[] = "/BENCH/TRACK.BIN";
+const unsigned long trackBytes = 65536;
+// Logger records, synced every 4 KB
+const unsigned long logBytes = 32768;
+
+SdFile dir;
+SdFile file;
+SdFile logFile;
+byte buffer[32];
+char name[13];
+cache_stats_t start;
+unsigned long testTime;
+
+// Keeps the counters at the start of a test
+void startTest(const char* test)
+{
+  Serial.print(test);
+  Serial.print(" : ");
+  sd.vol()->cacheStats(&start);
+  testTime = micros();
+}
+
+// Prints the counters since startTest()
+void endTest()
+{
+  testTime = micros() - testTime;
+  cache_stats_t now;
+  sd.vol()->cacheStats(&now);
+  unsigned long hits = now.hits - start.hits;
+  unsigned long misses = now.misses - start.misses;
+  
+  Serial.print(hits);
+  Serial.print(" hits, ");
+  Serial.print(misses);
+  Serial.print(" misses (");
+  Serial.print(hits + misses ? 100 * hits / (hits + misses) : 0);
+  Serial.print(" %), ");
+  Serial.print(now.reads - start.reads);
+  Serial.print(" blocks read, ");
+  Serial.print(now.writes - start.writes);
+  Serial.print(" written in ");
+  Serial.print(now.writeCommands - start.writeCommands);
+  Serial.print(" commands, ");
+  Serial.print(testTime / 1000);
+  Serial.println(" ms");
+}
+
+void fileName(int i)
+{
+  sprintf(name, "FILE%02d.TXT", i);
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  
+  // Sets up the card and the bus
+  player.begin();
+  Serial.print("Cache of ");
+  Serial.print(CACHE_BLOCK_COUNT);
+  Serial.println(" blocks");
+  
+  // Test files, only made once
+  if (!sd.exists("BENCH"))
+  {
+    sd.mkdir("BENCH");
+    for (int i = 0; i < files; i++)
+    {
+      fileName(i);
+      sd.chdir("/BENCH");
+      if (!file.open(name, O_CREAT | O_WRITE)) break;
+      file.println(name);
+      file.close();
+    }
+    sd.chdir("/");
+  }
+  if (!sd.exists(trackName) && file.open(trackName, O_CREAT | O_WRITE))
+  {
+    for (unsigned long bytes = 0; bytes < trackBytes; bytes += sizeof(buffer))
+    {
+      for (byte i = 0; i < sizeof(buffer); i++) buffer[i] = bytes + i;
+      if (file.write(buffer, sizeof(buffer)) != sizeof(buffer)) break;
+    }
+    file.close();
+  }
+  
+  // Every entry of the folder and the first bytes of each file
+  startTest("Directory scan");
+  for (int pass = 0; pass < 4; pass++)
+  {
+    dir.open("/BENCH", O_READ);
+    while (file.openNext(&dir, O_READ))
+    {
+      file.read(buffer, sizeof(buffer));
+      file.close();
+    }
+    dir.close();
+  }
+  endTest();
+  
+  // Each open searches the folder from its start
+  startTest("Open by name");
+  dir.open("/BENCH", O_READ);
+  for (int i = 0; i < files; i++)
+  {
+    fileName(i);
+    if (file.open(&dir, name, O_READ)) file.close();
+  }
+  dir.close();
+  endTest();
+  
+  // A track read like feed() does, with a line logged every block
+  startTest("Read and append");
+  if (file.open(trackName, O_READ) && file.fileSize() >= trackBytes
+      && logFile.open("/BENCH/LOG.TXT", O_CREAT | O_WRITE | O_APPEND))
+  {
+    unsigned long bytes = 0;
+    while (bytes < trackBytes && file.read(buffer, sizeof(buffer)) == sizeof(buffer))
+    {
+      bytes += sizeof(buffer);
+      if ((bytes & 511) == 0)
+      {
+        logFile.println(bytes);
+        if ((bytes & 2047) == 0) logFile.sync();
+      }
+    }
+    endTest();
+  }
+  else
+  {
+    Serial.print("can't read ");
+    Serial.println(trackName);
+  }
+  file.close();
+  logFile.close();
+  
+  // Records of 32 bytes, like a data logger
+  startTest("Logger");
+  if (logFile.open("/BENCH/LOGGER.TXT", O_CREAT | O_WRITE | O_TRUNC))
+  {
+    memset(buffer, 'x', sizeof(buffer));
+    for (unsigned long bytes = sizeof(buffer); bytes <= logBytes; bytes += sizeof(buffer))
+    {
+      logFile.write(buffer, sizeof(buffer));
+      if ((bytes & 4095) == 0) logFile.sync();
+    }
+  }
+  logFile.close();
+  endTest();
+}
+
+void loop()
+{
+}
@@ -0,0 +1,168 @@
+/*
+ * FAT scan benchmark for Tune shield by Snootlab
+ * Copyleft Snootlab 2015
+ *
+ * Circuit : any Arduino, the card isn't used
+ * Code : fills a FAT block in RAM with used and free entries, for
+ *  several fragmentation levels in FAT16 and FAT32, and times counting
+ *  its free entries, finding the first free one and finding a run of
+ *  8 free ones. Each is done an entry at a time, the way SdFat read the
+ *  FAT before, then with the FatScan.h functions it uses now.
+ *  Prints the microseconds per block of both.
+ *  The host core of extras/host doesn't charge CPU work, run it on a
+ *  board.
+ */
+
+// Libraries needed
+#include <SdFat.h>
+
+// Scans timed for each figure
+const int repeats = 100;
+// Free entries looked for by the run test
+const uint16_t runLength = 8;
+
+// The FAT block, as 32 bit words for the alignment of the entries
+uint32_t fat[128];
+uint8_t fatType;
+uint16_t entries;
+volatile uint16_t sink;
+
+// Fragmentation levels, the chance in 256 that an entry is free
+const char* levelName[] = {"full", "1 free", "1/16 free", "1/2 free", "runs", "empty"};
+const int levels = 6;
+
+bool isFree(uint16_t i)
+{
+  if (fatType == 32) return (fat[i] & 0X0FFFFFFF) == 0;
+  return ((uint16_t*)fat)[i] == 0;
+}
+
+void setEntry(uint16_t i, bool free)
+{
+  uint32_t value = free ? 0 : i + 3;
+  if (fatType == 32) fat[i] = value;
+  else ((uint16_t*)fat)[i] = value;
+}
+
+void fill(int level)
+{
+  randomSeed(level);
+  for (uint16_t i = 0; i < entries; i++)
+  {
+    bool free;
+    switch (level)
+    {
+      case 0 : free = false; break;
+      case 1 : free = i == entries - 1; break;
+      case 2 : free = random(16) == 0; break;
+      case 3 : free = random(2) == 0; break;
+      // runs of 6 free entries, too short, and one of 8 at the end
+      case 4 : free = i % 16 < 6 || i >= entries - runLength; break;
+      default : free = true; break;
+    }
+    setEntry(i, free);
+  }
+}
+
+// An entry at a time
+uint16_t countLoop()
+{
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < entries; i++) if (isFree(i)) n++;
+  return n;
+}
+
+uint16_t findLoop()
+{
+  uint16_t i = 0;
+  while (i < entries && !isFree(i)) i++;
+  return i;
+}
+
+uint16_t runLoop()
+{
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < entries; i++)
+  {
+    n = isFree(i) ? n + 1 : 0;
+    if (n == runLength) return i + 1 - n;
+  }
+  return entries;
+}
+
+// With the scan functions
+uint16_t runScan()
+{
+  uint16_t i = 0;
+  while (i < entries)
+  {
+    i = fatFindFree(fat, fatType, i, entries);
+    uint16_t used = fatFindUsed(fat, fatType, i, entries);
+    if (used - i >= runLength) return i;
+    i = used;
+  }
+  return entries;
+}
+
+// Prints the microseconds per block of a test that started at time
+void printTime(unsigned long time)
+{
+  time = micros() - time;
+  Serial.print(time / repeats);
+  Serial.print('.');
+  Serial.print(time % repeats / 10);
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  Serial.println("us per block, an entry at a time / FatScan.h");
+  for (fatType = 16; fatType <= 32; fatType += 16)
+  {
+    entries = fatType == 32 ? 128 : 256;
+    for (int level = 0; level < levels; level++)
+    {
+      fill(level);
+      Serial.print("FAT");
+      Serial.print(fatType);
+      Serial.print(' ');
+      Serial.print(levelName[level]);
+      Serial.print(" : count ");
+      unsigned long time = micros();
+      for (int r = 0; r < repeats; r++) sink = countLoop();
+      printTime(time);
+      Serial.print(" / ");
+      time = micros();
+      for (int r = 0; r < repeats; r++) sink = fatCountFree(fat, fatType, 0, entries);
+      printTime(time);
+      Serial.print(", first free ");
+      time = micros();
+      for (int r = 0; r < repeats; r++) sink = findLoop();
+      printTime(time);
+      Serial.print(" / ");
+      time = micros();
+      for (int r = 0; r < repeats; r++) sink = fatFindFree(fat, fatType, 0, entries);
+      printTime(time);
+      Serial.print(", run of 8 ");
+      time = micros();
+      for (int r = 0; r < repeats; r++) sink = runLoop();
+      printTime(time);
+      Serial.print(" / ");
+      time = micros();
+      for (int r = 0; r < repeats; r++) sink = runScan();
+      printTime(time);
+      Serial.println();
+      // Both ways have to agree
+      if (countLoop() != fatCountFree(fat, fatType, 0, entries)
+          || findLoop() != fatFindFree(fat, fatType, 0, entries)
+          || runLoop() != runScan())
+      {
+        Serial.println("Scan results differ !");
+      }
+    }
+  }
+}
+
+void loop()
+{
+}
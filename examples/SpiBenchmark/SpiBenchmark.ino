@@ -0,0 +1,133 @@
+/*
+ * SPI benchmark for Tune shield by Snootlab
+ * Copyleft Snootlab 2015
+ *
+ * Circuit : Arduino Uno/Mega, Tune shield with an SD card
+ * Code : moves 512 byte blocks on the SPI bus with no chip selected,
+ *  one byte per SPI.transfer() call then with the block transfers,
+ *  and reads blocks from the SD card through SdFat.
+ *  Prints the speed of each in KB/s, then the CPU cycles of a chip
+ *  select write and a DREQ read with the Arduino calls and with the
+ *  DigitalPin.h ones Tune uses.
+ */
+
+// Libraries needed
+#include <Tune.h>
+#include <SdFat.h>
+#include <SPI.h>
+#include <utility/DigitalPin.h>
+
+// Object declaration
+Tune player;
+
+// Blocks moved by each test
+const int blocks = 64;
+byte block[512];
+
+// Calls made by each pin test
+const unsigned int calls = 1000;
+volatile bool level;
+
+// Prints the speed of a test that started at time
+void printSpeed(const char* name, unsigned long time)
+{
+  time = micros() - time;
+  Serial.print(name);
+  Serial.print(" : ");
+  Serial.print(blocks * 512000UL / time);
+  Serial.println(" KB/s");
+}
+
+// Prints the CPU cycles per call of a pin test that started at time
+void printCycles(const char* name, unsigned long time)
+{
+  time = micros() - time;
+  Serial.print(name);
+  Serial.print(" : ");
+  Serial.print(time * (F_CPU / 1000000UL) / calls);
+  Serial.println(" cycles");
+}
+
+void setup()
+{
+  Serial.begin(9600);
+  
+  // Sets up the card and the bus, SPI_CLOCK_DIV4
+  player.begin();
+  
+  unsigned long time = micros();
+  for (int b = 0; b < blocks; b++)
+  {
+    for (int i = 0; i < 512; i++)
+    {
+      SPI.transfer(block[i]);
+    }
+  }
+  printSpeed("SPI.transfer(byte) loop", time);
+  
+  time = micros();
+  for (int b = 0; b < blocks; b++)
+  {
+    SPI.transfer(block, sizeof(block));
+  }
+  printSpeed("SPI.transfer(buf, n)", time);
+  
+  time = micros();
+  for (int b = 0; b < blocks; b++)
+  {
+    SPI.transfer(block, NULL, sizeof(block));
+  }
+  printSpeed("SPI.transfer(buf, NULL, n) send", time);
+  
+  time = micros();
+  for (int b = 0; b < blocks; b++)
+  {
+    SPI.transfer(NULL, block, sizeof(block));
+  }
+  printSpeed("SPI.transfer(NULL, buf, n) receive", time);
+  
+  // Card reads use the SdFat SPI backend chosen in SdFatConfig.h
+  time = micros();
+  for (int b = 0; b < blocks; b++)
+  {
+    if (!sd.card()->readBlock(b, block))
+    {
+      Serial.println("SD read error");
+      return;
+    }
+  }
+  printSpeed("SD card readBlock()", time);
+  
+  // Pin tests, the loop itself is counted too
+  time = micros();
+  for (unsigned int i = 0; i < calls; i++)
+  {
+    digitalWrite(XCS, HIGH);
+  }
+  printCycles("digitalWrite(XCS, HIGH)", time);
+  
+  time = micros();
+  for (unsigned int i = 0; i < calls; i++)
+  {
+    fastDigitalWrite(XCS, HIGH);
+  }
+  printCycles("fastDigitalWrite(XCS, HIGH)", time);
+  
+  time = micros();
+  for (unsigned int i = 0; i < calls; i++)
+  {
+    level = digitalRead(DREQ);
+  }
+  printCycles("digitalRead(DREQ)", time);
+  
+  time = micros();
+  for (unsigned int i = 0; i < calls; i++)
+  {
+    level = fastDigitalRead(DREQ);
+  }
+  printCycles("fastDigitalRead(DREQ)", time);
+}
+
+void loop()
+{
+}
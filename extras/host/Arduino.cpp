@@ -0,0 +1,377 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ */
+#include <poll.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include <avr/eeprom.h>
+//------------------------------------------------------------------------------
+/** Picoseconds per CPU cycle. */
+static const uint64_t PS_PER_CYCLE = 1000000000000ULL / F_CPU;
+/** Longest step of simulated time between interrupt checks in delay(). */
+static const uint64_t DELAY_STEP_PS = 4000000ULL;
+/** Number of external interrupts, INT0 on pin 2 and INT1 on pin 3. */
+static const uint8_t INT_COUNT = 2;
+/** Number of device tasks and of pending peripheral interrupts. */
+static const uint8_t TASK_COUNT = 4;
+
+struct HostPin {
+  uint8_t mode;
+  uint8_t out;
+  HostPinDriver* drv;
+};
+struct HostIrq {
+  void (*isr)(void);
+  int mode;
+  uint8_t level;
+  bool pending;
+  bool active;
+};
+static uint64_t g_ps = 0;
+static HostPin g_pin[NUM_DIGITAL_PINS];
+static HostIrq g_irq[INT_COUNT];
+static bool g_enabled = true;
+static uint8_t g_mask = 0;
+static uint32_t g_interrupts = 0;
+static void (*g_task[TASK_COUNT])(void);
+static void (*g_raised[TASK_COUNT])(void);
+static bool g_inTask = false;
+static uint8_t g_eeprom[E2END + 1];
+static bool g_eepromInit = false;
+static FILE* g_eepromFile = 0;
+HardwareSerial Serial;
+//------------------------------------------------------------------------------
+static uint8_t pinLevel(uint8_t pin) {
+  if (pin >= NUM_DIGITAL_PINS) {
+    return LOW;
+  }
+  HostPin* p = &g_pin[pin];
+  if (p->drv) {
+    return p->drv->pinLevel(pin) ? HIGH : LOW;
+  }
+  if (p->mode == OUTPUT) {
+    return p->out;
+  }
+  return p->mode == INPUT_PULLUP ? HIGH : LOW;
+}
+//------------------------------------------------------------------------------
+// Run an interrupt handler, AVR clears the I flag on entry and sets it
+// again with RETI.
+static void service(void (*isr)(void)) {
+  g_enabled = false;
+  g_interrupts++;
+  g_ps += HOST_CYCLES_INTERRUPT * PS_PER_CYCLE;
+  isr();
+  g_enabled = true;
+}
+//------------------------------------------------------------------------------
+// Let devices catch up, latch edges and run the handlers that are pending
+// and allowed to run.
+static void dispatch() {
+  if (!g_inTask) {
+    g_inTask = true;
+    for (uint8_t i = 0; i < TASK_COUNT && g_task[i]; i++) {
+      g_task[i]();
+    }
+    g_inTask = false;
+  }
+  bool again;
+  do {
+    again = false;
+    for (uint8_t i = 0; g_enabled && i < TASK_COUNT; i++) {
+      void (*isr)(void) = g_raised[i];
+      if (isr) {
+        g_raised[i] = 0;
+        service(isr);
+        again = true;
+      }
+    }
+    for (uint8_t i = 0; i < INT_COUNT; i++) {
+      HostIrq* q = &g_irq[i];
+      if (!q->isr) {
+        continue;
+      }
+      uint8_t level = pinLevel(2 + i);
+      if (level != q->level) {
+        if (q->mode == CHANGE || (q->mode == RISING && level)
+            || (q->mode == FALLING && !level)) {
+          q->pending = true;
+        }
+        q->level = level;
+      }
+      if (q->mode == LOW && !level) {
+        q->pending = true;
+      }
+      if (q->pending && g_enabled && !q->active && (g_mask & (1 << i))) {
+        q->pending = false;
+        q->active = true;
+        service(q->isr);
+        q->active = false;
+        again = true;
+      }
+    }
+  } while (again);
+}
+//------------------------------------------------------------------------------
+void hostAdvance(uint64_t ns) {
+  g_ps += ns * 1000;
+  dispatch();
+}
+//------------------------------------------------------------------------------
+void hostCycles(uint32_t cycles) {
+  g_ps += cycles * PS_PER_CYCLE;
+  dispatch();
+}
+//------------------------------------------------------------------------------
+uint64_t hostNanos() {
+  return g_ps / 1000;
+}
+//------------------------------------------------------------------------------
+uint8_t hostInterruptMask() {
+  return g_mask;
+}
+//------------------------------------------------------------------------------
+void hostSetInterruptMask(uint8_t mask) {
+  g_mask = mask;
+  dispatch();
+}
+//------------------------------------------------------------------------------
+uint32_t hostInterruptCount() {
+  return g_interrupts;
+}
+//------------------------------------------------------------------------------
+bool hostAddTask(void (*task)(void)) {
+  for (uint8_t i = 0; i < TASK_COUNT; i++) {
+    if (!g_task[i] || g_task[i] == task) {
+      g_task[i] = task;
+      return true;
+    }
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+void hostRaise(void (*isr)(void)) {
+  uint8_t i = 0;
+  // Like an interrupt flag, a second request before the handler runs is lost.
+  while (i < TASK_COUNT && g_raised[i] && g_raised[i] != isr) {
+    i++;
+  }
+  if (i < TASK_COUNT) {
+    g_raised[i] = isr;
+  }
+}
+//------------------------------------------------------------------------------
+void hostDrivePin(uint8_t pin, HostPinDriver* drv) {
+  if (pin < NUM_DIGITAL_PINS) {
+    g_pin[pin].drv = drv;
+  }
+}
+//------------------------------------------------------------------------------
+uint8_t hostPinOutput(uint8_t pin) {
+  // Pins that are not outputs float high, chip selects have pull-ups.
+  if (pin >= NUM_DIGITAL_PINS || g_pin[pin].mode != OUTPUT) {
+    return HIGH;
+  }
+  return g_pin[pin].out;
+}
+//------------------------------------------------------------------------------
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < NUM_DIGITAL_PINS) {
+    g_pin[pin].mode = mode;
+    if (mode == INPUT_PULLUP) {
+      g_pin[pin].out = HIGH;
+    }
+  }
+  hostCycles(HOST_CYCLES_PIN_MODE);
+}
+//------------------------------------------------------------------------------
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin < NUM_DIGITAL_PINS) {
+    g_pin[pin].out = val ? HIGH : LOW;
+  }
+  hostCycles(HOST_CYCLES_DIGITAL_WRITE);
+}
+//------------------------------------------------------------------------------
+int digitalRead(uint8_t pin) {
+  hostCycles(HOST_CYCLES_DIGITAL_READ);
+  return pinLevel(pin);
+}
+//------------------------------------------------------------------------------
+void hostFastPinMode(uint8_t pin, bool mode) {
+  if (pin < NUM_DIGITAL_PINS) {
+    g_pin[pin].mode = mode ? OUTPUT : INPUT;
+  }
+  hostCycles(HOST_CYCLES_FAST_PIN);
+}
+//------------------------------------------------------------------------------
+void hostFastWrite(uint8_t pin, bool level) {
+  if (pin < NUM_DIGITAL_PINS) {
+    g_pin[pin].out = level ? HIGH : LOW;
+  }
+  hostCycles(HOST_CYCLES_FAST_PIN);
+}
+//------------------------------------------------------------------------------
+bool hostFastRead(uint8_t pin) {
+  hostCycles(HOST_CYCLES_FAST_PIN);
+  return pinLevel(pin);
+}
+//------------------------------------------------------------------------------
+int analogRead(uint8_t pin) {
+  (void)pin;
+  // A conversion takes 13 ADC clocks at F_CPU/128.
+  hostCycles(13 * 128);
+  return 0;
+}
+//------------------------------------------------------------------------------
+void analogWrite(uint8_t pin, int val) {
+  digitalWrite(pin, val > 127 ? HIGH : LOW);
+}
+//------------------------------------------------------------------------------
+unsigned long millis() {
+  hostCycles(HOST_CYCLES_MILLIS);
+  return static_cast<uint32_t>(g_ps / 1000000000ULL);
+}
+//------------------------------------------------------------------------------
+unsigned long micros() {
+  hostCycles(HOST_CYCLES_MICROS);
+  return static_cast<uint32_t>(g_ps / 1000000ULL);
+}
+//------------------------------------------------------------------------------
+void delay(unsigned long ms) {
+  uint64_t end = g_ps + ms * 1000000000ULL;
+  while (g_ps < end) {
+    uint64_t step = end - g_ps;
+    g_ps += step < DELAY_STEP_PS ? step : DELAY_STEP_PS;
+    dispatch();
+  }
+}
+//------------------------------------------------------------------------------
+void delayMicroseconds(unsigned int us) {
+  hostAdvance(us * 1000ULL);
+}
+//------------------------------------------------------------------------------
+void attachInterrupt(uint8_t num, void (*isr)(void), int mode) {
+  if (num < INT_COUNT) {
+    HostIrq* q = &g_irq[num];
+    q->level = pinLevel(2 + num);
+    q->mode = mode;
+    q->pending = false;
+    q->isr = isr;
+    g_mask |= 1 << num;
+  }
+  dispatch();
+}
+//------------------------------------------------------------------------------
+void detachInterrupt(uint8_t num) {
+  if (num < INT_COUNT) {
+    g_irq[num].isr = 0;
+    g_mask &= ~(1 << num);
+  }
+}
+//------------------------------------------------------------------------------
+void cli() {
+  g_enabled = false;
+}
+//------------------------------------------------------------------------------
+void sei() {
+  g_enabled = true;
+  dispatch();
+}
+//------------------------------------------------------------------------------
+void yield() {
+  hostCycles(4);
+}
+//------------------------------------------------------------------------------
+long random(long howbig) {
+  return howbig ? ::random() % howbig : 0;
+}
+//------------------------------------------------------------------------------
+long random(long howsmall, long howbig) {
+  return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+//------------------------------------------------------------------------------
+void randomSeed(unsigned long seed) {
+  if (seed) {
+    srandom(seed);
+  }
+}
+//==============================================================================
+// Serial is stdin and stdout. Output costs no simulated time.
+int HardwareSerial::available() {
+  hostCycles(8);
+  if (m_peek < 0) {
+    struct pollfd pfd = {0, POLLIN, 0};
+    if (poll(&pfd, 1, 0) == 1) {
+      unsigned char c;
+      if (::read(0, &c, 1) == 1) {
+        m_peek = c;
+      }
+    }
+  }
+  return m_peek < 0 ? 0 : 1;
+}
+//------------------------------------------------------------------------------
+int HardwareSerial::peek() {
+  return available() ? m_peek : -1;
+}
+//------------------------------------------------------------------------------
+int HardwareSerial::read() {
+  int c = peek();
+  m_peek = -1;
+  return c;
+}
+//------------------------------------------------------------------------------
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+//------------------------------------------------------------------------------
+size_t HardwareSerial::write(uint8_t b) {
+  if (b != '\r') {
+    putchar(b);
+  }
+  return 1;
+}
+//==============================================================================
+// EEPROM, erased until it is first used or loaded.
+static void eepromInit() {
+  if (!g_eepromInit) {
+    memset(g_eeprom, 0XFF, sizeof(g_eeprom));
+    g_eepromInit = true;
+  }
+}
+//------------------------------------------------------------------------------
+bool hostEepromFile(const char* path) {
+  eepromInit();
+  g_eepromFile = fopen(path, "r+b");
+  if (g_eepromFile) {
+    if (fread(g_eeprom, 1, sizeof(g_eeprom), g_eepromFile)) {}
+  } else {
+    g_eepromFile = fopen(path, "w+b");
+  }
+  return g_eepromFile != 0;
+}
+//------------------------------------------------------------------------------
+uint8_t eeprom_read_byte(const uint8_t* addr) {
+  eepromInit();
+  hostCycles(HOST_CYCLES_EEPROM_READ);
+  return g_eeprom[reinterpret_cast<uintptr_t>(addr) & E2END];
+}
+//------------------------------------------------------------------------------
+void eeprom_write_byte(uint8_t* addr, uint8_t value) {
+  eepromInit();
+  hostCycles(HOST_CYCLES_EEPROM_WRITE);
+  g_eeprom[reinterpret_cast<uintptr_t>(addr) & E2END] = value;
+  if (g_eepromFile) {
+    rewind(g_eepromFile);
+    fwrite(g_eeprom, 1, sizeof(g_eeprom), g_eepromFile);
+    fflush(g_eepromFile);
+  }
+}
+//------------------------------------------------------------------------------
+void eeprom_update_byte(uint8_t* addr, uint8_t value) {
+  if (eeprom_read_byte(addr) != value) {
+    eeprom_write_byte(addr, value);
+  }
+}
@@ -0,0 +1,200 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * Minimal Arduino API for running the library on a PC with virtual
+ * peripherals. Time is simulated: every call into the core charges the
+ * number of CPU cycles it would take on an ATmega328P at F_CPU, and
+ * SPI transfers charge the bus time of each byte. Pin change interrupts
+ * are dispatched whenever simulated time moves forward, so interrupt
+ * driven code such as Tune::feed() runs the same way it does on target.
+ *
+ * See extras/host/README.md for build instructions.
+ */
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+#ifndef ARDUINO_ARCH_HOST
+#define ARDUINO_ARCH_HOST
+#endif  // ARDUINO_ARCH_HOST
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif  // F_CPU
+
+/** Last EEPROM address of an ATmega328P, avr/io.h has it on target. */
+#define E2END 0x3FF
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef unsigned int word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+/** Number of simulated digital pins (Uno layout). */
+#define NUM_DIGITAL_PINS 20
+#define SS 10
+#define MOSI 11
+#define MISO 12
+#define SCK 13
+#define LED_BUILTIN 13
+#define A0 14
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+
+#define _BV(b) (1UL << (b))
+#define bit(b) (1UL << (b))
+#define bitRead(value, b) (((value) >> (b)) & 0x01)
+#define bitSet(value, b) ((value) |= (1UL << (b)))
+#define bitClear(value, b) ((value) &= ~(1UL << (b)))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+inline unsigned int makeWord(unsigned int w) {return w;}
+inline unsigned int makeWord(uint8_t h, uint8_t l) {return h << 8 | l;}
+#define word(...) makeWord(__VA_ARGS__)
+// Bounds compared in the type of the value, like the AVR core's int arguments.
+template<class T, class L, class H>
+inline T constrain(T x, L lo, H hi) {
+  return x < static_cast<T>(lo) ? static_cast<T>(lo)
+         : (x > static_cast<T>(hi) ? static_cast<T>(hi) : x);
+}
+
+template<class T, class U>
+inline T min(T a, U b) {return b < a ? static_cast<T>(b) : a;}
+template<class T, class U>
+inline T max(T a, U b) {return a < b ? static_cast<T>(b) : a;}
+
+// Flash strings live in RAM on the host.
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strcasecmp_P strcasecmp
+#define memcpy_P memcpy
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+//------------------------------------------------------------------------------
+// Arduino API
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void attachInterrupt(uint8_t num, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t num);
+void cli();
+void sei();
+#define interrupts() sei()
+#define noInterrupts() cli()
+void yield();
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+//------------------------------------------------------------------------------
+// Host hooks for the virtual peripherals
+/**
+ * \class HostPinDriver
+ * \brief A device that drives a digital input pin.
+ */
+class HostPinDriver {
+ public:
+  /** \return level of the driven pin at the current simulated time. */
+  virtual int pinLevel(uint8_t pin) = 0;
+};
+/** Connect a device output to a pin, or 0 to disconnect it. */
+void hostDrivePin(uint8_t pin, HostPinDriver* drv);
+/** \return level of an output pin, HIGH if the pin is not an output. */
+uint8_t hostPinOutput(uint8_t pin);
+/** Direct port access for DigitalPin.h, charged like sbi, cbi and sbic.
+ *  The mode is true for output, an input keeps its pull-up setting. */
+void hostFastPinMode(uint8_t pin, bool mode);
+void hostFastWrite(uint8_t pin, bool level);
+bool hostFastRead(uint8_t pin);
+/** \return simulated time in nanoseconds since reset. */
+uint64_t hostNanos();
+/** Charge CPU cycles and dispatch pending interrupts. */
+void hostCycles(uint32_t cycles);
+/** Advance simulated time and dispatch pending interrupts. */
+void hostAdvance(uint64_t ns);
+/** \return external interrupt enable bits, like EIMSK on AVR. */
+uint8_t hostInterruptMask();
+/** Set external interrupt enable bits, like EIMSK on AVR. */
+void hostSetInterruptMask(uint8_t mask);
+/** \return number of interrupts dispatched since reset. */
+uint32_t hostInterruptCount();
+/** Run a task each time simulated time moves, for devices that work on
+ *  their own like a DMA controller. */
+bool hostAddTask(void (*task)(void));
+/** Request a peripheral interrupt, its handler runs at the next step of
+ *  simulated time with interrupts enabled. */
+void hostRaise(void (*isr)(void));
+/** Load the EEPROM from a file, created if needed, and write it back there
+ *  at each change. */
+bool hostEepromFile(const char* path);
+
+/** Simulated cost of core calls in CPU cycles (ATmega328P, core 1.6). */
+#define HOST_CYCLES_DIGITAL_WRITE 56
+#define HOST_CYCLES_DIGITAL_READ 50
+#define HOST_CYCLES_PIN_MODE 60
+#define HOST_CYCLES_MICROS 50
+#define HOST_CYCLES_MILLIS 30
+#define HOST_CYCLES_INTERRUPT 80
+#define HOST_CYCLES_FAST_PIN 2
+#define HOST_CYCLES_EEPROM_READ 4
+/** An EEPROM byte write takes 3.4 ms. */
+#define HOST_CYCLES_EEPROM_WRITE 54400
+/** Call of loop() and serialEventRun() by main(), an empty loop() runs. */
+#define HOST_CYCLES_LOOP 12
+//------------------------------------------------------------------------------
+#include "Print.h"
+#include "Stream.h"
+/**
+ * \class HardwareSerial
+ * \brief Serial port mapped to stdin and stdout.
+ */
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud) {(void)baud;}
+  void end() {}
+  int available();
+  int read();
+  int peek();
+  void flush();
+  size_t write(uint8_t b);
+  using Print::write;
+  operator bool() {return true;}
+ private:
+  int m_peek = -1;
+};
+extern HardwareSerial Serial;
+
+void setup();
+void loop();
+#endif  // Arduino_h
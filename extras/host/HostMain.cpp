@@ -0,0 +1,150 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * main() for running a sketch on the host with the Tune shield wiring:
+ * SD card on pin 10, VS1011 XCS on pin 8, XDCS on pin 4, DREQ on pin 2.
+ *
+ *   sketch [-i image] [-c capture] [-e eeprom] [-k divisor] [-p blocks]
+ *          [-u ms] [-t seconds] [-w seconds]
+ *
+ *   -i  disk image of the SD card, default sd.img
+ *   -c  write the SDI stream sent to the codec to a file
+ *   -e  file keeping the EEPROM from one run to the next
+ *   -k  smallest SCK divisor the card reads at without errors
+ *   -p  cut the power of the card after this many blocks written
+ *   -u  print a bus utilisation line to stderr every ms milliseconds
+ *   -t  stop after this much simulated time, default 60, 0 runs forever
+ *   -w  stop after this much wall clock time, default 60, 0 runs forever
+ *
+ * Bus and device statistics are printed to stderr on exit, including
+ * exit() from the sketch.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "VirtualSdCard.h"
+#include "VirtualVs1011.h"
+
+static VirtualSdCard sdCard;
+static VirtualVs1011 codec;
+// Devices in the order they're attached to the bus.
+enum {DEV_SD, DEV_SCI, DEV_SDI};
+static uint64_t traceNanos = 0;
+//------------------------------------------------------------------------------
+// SCK time used, over the elapsed time and over the time of the bursts.
+static void printUse(uint64_t busy, uint64_t active, uint64_t elapsed) {
+  fprintf(stderr, "%5.1f%% of time, %5.1f%% of bursts",
+          elapsed ? 100.0 * busy / elapsed : 0.0,
+          active ? 100.0 * busy / active : 0.0);
+}
+//------------------------------------------------------------------------------
+// One line per interval: bus use and bytes for the card and the codec.
+static void trace() {
+  static uint64_t next = 0;
+  static uint64_t busy = 0;
+  static uint64_t active = 0;
+  static uint32_t sd = 0;
+  static uint32_t sdi = 0;
+  uint64_t now = hostNanos();
+  if (now < next) {
+    return;
+  }
+  if (next) {
+    fprintf(stderr, "util %10.3f s spi ", now / 1e9);
+    printUse(HostSpi.busyNanos - busy, HostSpi.activeNanos - active,
+             now - next + traceNanos);
+    fprintf(stderr, ", sd %u B, sdi %u B, codec fill %u\n",
+            HostSpi.deviceBytes[DEV_SD] - sd,
+            HostSpi.deviceBytes[DEV_SDI] - sdi, codec.fill());
+  }
+  busy = HostSpi.busyNanos;
+  active = HostSpi.activeNanos;
+  sd = HostSpi.deviceBytes[DEV_SD];
+  sdi = HostSpi.deviceBytes[DEV_SDI];
+  next = now + traceNanos;
+}
+//------------------------------------------------------------------------------
+static void report() {
+  fflush(stdout);
+  fprintf(stderr, "time %.6f s, interrupts %u\n",
+          hostNanos() / 1e9, hostInterruptCount());
+  fprintf(stderr, "spi %u bytes, %.6f s busy, %u idle, %u contention\n",
+          HostSpi.bytes, HostSpi.busyNanos / 1e9,
+          HostSpi.idleBytes, HostSpi.contention);
+  fprintf(stderr, "spi use ");
+  printUse(HostSpi.busyNanos, HostSpi.activeNanos, hostNanos());
+  fprintf(stderr, ", sd %u B, sdi %u B\n",
+          HostSpi.deviceBytes[DEV_SD], HostSpi.deviceBytes[DEV_SDI]);
+  if (HostSpi.asyncBytes) {
+    fprintf(stderr, "spi async %u bytes, %u collisions\n",
+            HostSpi.asyncBytes, HostSpi.collisions);
+  }
+  fprintf(stderr, "sd %u commands, %u blocks read in %u commands, "
+          "%u blocks written in %u commands, %u crc errors, %u errors\n",
+          sdCard.commands, sdCard.blocksRead, sdCard.readCommands,
+          sdCard.blocksWritten, sdCard.writeCommands,
+          sdCard.crcErrors, sdCard.errors);
+  if (sdCard.powerCut()) {
+    fprintf(stderr, "sd power cut after %u blocks written\n",
+            sdCard.powerCutBlocks);
+  }
+  fprintf(stderr, "vs1011 %u sdi bytes, %u underruns, %u overflows\n",
+          codec.sdiBytes, codec.underruns, codec.overflows);
+}
+//------------------------------------------------------------------------------
+static void watchdog(int sig) {
+  (void)sig;
+  fprintf(stderr, "\nwall clock limit reached\n");
+  report();
+  _exit(2);
+}
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+  const char* image = "sd.img";
+  const char* capture = 0;
+  const char* eeprom = 0;
+  double limit = 60;
+  unsigned wall = 60;
+  int opt;
+  while ((opt = getopt(argc, argv, "i:c:e:k:p:u:t:w:")) != -1) {
+    switch (opt) {
+      case 'i': image = optarg; break;
+      case 'c': capture = optarg; break;
+      case 'e': eeprom = optarg; break;
+      case 'k': sdCard.minDivisor = atoi(optarg); break;
+      case 'p': sdCard.powerCutBlocks = atoi(optarg); break;
+      case 'u': traceNanos = atof(optarg) * 1e6; break;
+      case 't': limit = atof(optarg); break;
+      case 'w': wall = atoi(optarg); break;
+      default:
+        fprintf(stderr, "usage: %s [-i image] [-c capture] [-e eeprom] "
+                "[-k divisor] [-p blocks] [-u ms] [-t seconds] [-w seconds]\n", argv[0]);
+        return 1;
+    }
+  }
+  if (!sdCard.begin(image)) {
+    fprintf(stderr, "no SD card image %s\n", image);
+  }
+  codec.begin(8, 4, 2);
+  if (capture && !codec.capture(capture)) {
+    fprintf(stderr, "can't create %s\n", capture);
+    return 1;
+  }
+  if (eeprom && !hostEepromFile(eeprom)) {
+    fprintf(stderr, "can't open %s\n", eeprom);
+    return 1;
+  }
+  if (traceNanos) {
+    hostAddTask(trace);
+  }
+  atexit(report);
+  signal(SIGALRM, watchdog);
+  alarm(wall);
+  setup();
+  while (limit <= 0 || hostNanos() < limit * 1e9) {
+    loop();
+    hostCycles(HOST_CYCLES_LOOP);
+  }
+  return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ */
+// Through SPI.h, for its SPI_PROFILE setting.
+#include <SPI.h>
+
+HostSpiBus HostSpi;
+SPIClass SPI;
+
+uint8_t SPIClass::initialized = 0;
+uint8_t SPIClass::interruptMode = 0;
+uint8_t SPIClass::interruptMask = 0;
+uint8_t SPIClass::interruptSave = 0;
+//------------------------------------------------------------------------------
+static uint8_t reverse(uint8_t b) {
+  b = (b & 0XF0) >> 4 | (b & 0X0F) << 4;
+  b = (b & 0XCC) >> 2 | (b & 0X33) << 2;
+  return (b & 0XAA) >> 1 | (b & 0X55) << 1;
+}
+//------------------------------------------------------------------------------
+HostSpiBus::HostSpiBus() : m_count(0), m_divisor(4), m_lsbFirst(false),
+  m_asyncLeft(0), m_asyncDone(0), m_lastEnd(0) {
+  resetStats();
+}
+//------------------------------------------------------------------------------
+bool HostSpiBus::attach(uint8_t csPin, HostSpiDevice* dev) {
+  if (m_count >= HOST_SPI_MAX_DEVICES) {
+    return false;
+  }
+  m_cs[m_count] = csPin;
+  m_selected[m_count] = false;
+  m_dev[m_count++] = dev;
+  return true;
+}
+//------------------------------------------------------------------------------
+void HostSpiBus::setDivisor(uint8_t divisor) {
+  uint8_t d = 2;
+  while (d < divisor && d < 128) {
+    d <<= 1;
+  }
+  m_divisor = d;
+}
+//------------------------------------------------------------------------------
+void HostSpiBus::resetStats() {
+  bytes = 0;
+  idleBytes = 0;
+  contention = 0;
+  busyNanos = 0;
+  activeNanos = 0;
+  memset(deviceBytes, 0, sizeof(deviceBytes));
+  asyncBytes = 0;
+  collisions = 0;
+}
+//------------------------------------------------------------------------------
+// Route a byte to the selected devices and count it, takes no time.
+uint8_t HostSpiBus::exchange(uint8_t data) {
+  uint8_t rtn = 0XFF;
+  uint8_t n = 0;
+  if (m_lsbFirst) {
+    data = reverse(data);
+  }
+  for (uint8_t i = 0; i < m_count; i++) {
+    bool sel = hostPinOutput(m_cs[i]) == LOW;
+    if (sel != m_selected[i]) {
+      m_selected[i] = sel;
+      if (sel) {
+        m_dev[i]->select();
+      } else {
+        m_dev[i]->deselect();
+      }
+    }
+    if (sel) {
+      uint8_t b = m_dev[i]->transfer(data);
+      rtn = n++ ? rtn & b : b;
+      deviceBytes[i]++;
+    }
+  }
+  if (n == 0) {
+    idleBytes++;
+  } else if (n > 1) {
+    contention++;
+  }
+  bytes++;
+  uint64_t now = hostNanos();
+  uint64_t gap = now - m_lastEnd;
+  activeNanos += byteNanos() + (gap <= HOST_SPI_BURST_GAP_NANOS ? gap : 0);
+  m_lastEnd = now + byteNanos();
+  busyNanos += byteNanos();
+  return m_lsbFirst ? reverse(rtn) : rtn;
+}
+//------------------------------------------------------------------------------
+uint8_t HostSpiBus::transfer(uint8_t data, uint8_t overhead) {
+  if (m_asyncLeft) {
+    collisions++;
+    while (m_asyncLeft) {
+      hostAdvance(byteNanos());
+    }
+  }
+  uint8_t rtn = exchange(data);
+  hostCycles(8UL * m_divisor + overhead);
+  return rtn;
+}
+//------------------------------------------------------------------------------
+bool HostSpiBus::startAsync(const uint8_t* tx, uint8_t* rx, size_t n,
+                            HostSpiCallback done) {
+  if (m_asyncLeft || !hostAddTask(asyncTask)) {
+    return false;
+  }
+  m_asyncTx = tx;
+  m_asyncRx = rx;
+  m_asyncDone = done;
+  m_asyncNext = hostNanos() + byteNanos();
+  m_asyncLeft = n;
+  if (n == 0) {
+    hostRaise(asyncIsr);
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// Clock the bytes of the asynchronous transfer that are due.
+void HostSpiBus::asyncTask() {
+  HostSpiBus* bus = &HostSpi;
+  while (bus->m_asyncLeft && hostNanos() >= bus->m_asyncNext) {
+    uint8_t b = bus->exchange(bus->m_asyncTx ? *bus->m_asyncTx++ : 0XFF);
+    if (bus->m_asyncRx) {
+      *bus->m_asyncRx++ = b;
+    }
+    bus->asyncBytes++;
+    bus->m_asyncNext += bus->byteNanos();
+    if (--bus->m_asyncLeft == 0) {
+      hostRaise(asyncIsr);
+    }
+  }
+}
+//------------------------------------------------------------------------------
+void HostSpiBus::asyncIsr() {
+  HostSpiCallback done = HostSpi.m_asyncDone;
+  HostSpi.m_asyncDone = 0;
+  if (done) {
+    done(0);
+  }
+}
+//==============================================================================
+void SPIClass::begin() {
+  if (!initialized) {
+    digitalWrite(SS, HIGH);
+    pinMode(SS, OUTPUT);
+    pinMode(SCK, OUTPUT);
+    pinMode(MOSI, OUTPUT);
+  }
+  initialized++;
+}
+//------------------------------------------------------------------------------
+void SPIClass::end() {
+  if (initialized) {
+    initialized--;
+  }
+  if (!initialized) {
+    interruptMode = 0;
+  }
+}
+//------------------------------------------------------------------------------
+void SPIClass::usingInterrupt(uint8_t interruptNumber) {
+  if (interruptNumber < 2) {
+    interruptMask |= 1 << interruptNumber;
+  } else {
+    interruptMode = 2;
+  }
+  if (!interruptMode) {
+    interruptMode = 1;
+  }
+}
+//------------------------------------------------------------------------------
+void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
+  if (interruptMode == 2) {
+    return;
+  }
+  if (interruptNumber < 2) {
+    interruptMask &= ~(1 << interruptNumber);
+  }
+  if (!interruptMask) {
+    interruptMode = 0;
+  }
+}
+//------------------------------------------------------------------------------
+void SPIClass::beginTransaction(SPISettings settings) {
+  if (interruptMode == 1) {
+    interruptSave = hostInterruptMask();
+    hostSetInterruptMask(interruptSave & ~interruptMask);
+  } else if (interruptMode == 2) {
+    noInterrupts();
+  }
+#ifdef SPI_PROFILE
+  SPIProfile::begin(settings.divisor << 8 | settings.order << 4 | settings.mode,
+                    interruptMode > 0);
+#endif  // SPI_PROFILE
+  HostSpi.setDivisor(settings.divisor);
+  HostSpi.setBitOrder(settings.order);
+}
+//------------------------------------------------------------------------------
+void SPIClass::endTransaction(void) {
+#ifdef SPI_PROFILE
+  SPIProfile::end();
+#endif  // SPI_PROFILE
+  if (interruptMode == 1) {
+    hostSetInterruptMask(interruptSave);
+  } else if (interruptMode == 2) {
+    interrupts();
+  }
+}
+//------------------------------------------------------------------------------
+void SPIClass::setClockDivider(uint8_t clockDiv) {
+  static const uint8_t divisor[] = {4, 16, 64, 128, 2, 8, 32};
+  HostSpi.setDivisor(clockDiv < 7 ? divisor[clockDiv] : 128);
+}
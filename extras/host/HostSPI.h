@@ -0,0 +1,221 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * SPI library for the host build. SPI.h includes this file when
+ * ARDUINO_ARCH_HOST is defined. Bytes go to the virtual device whose
+ * chip select pin is low and each byte charges 8 SCK periods plus the
+ * loop overhead of the caller to the simulated clock.
+ *
+ * An asynchronous transfer is clocked by the bus alone, like DMA: its bytes
+ * go out as simulated time moves and a completion handler runs as an
+ * interrupt after the last one.
+ */
+#ifndef HostSPI_h
+#define HostSPI_h
+
+#include <Arduino.h>
+#ifdef SPI_PROFILE
+#include <SPIProfile.h>
+#endif  // SPI_PROFILE
+
+#define SPI_HAS_TRANSACTION 1
+#define SPI_HAS_NOTUSINGINTERRUPT 1
+#define SPI_ATOMIC_VERSION 1
+#define SPI_HAS_BLOCK_TRANSFER 1
+
+#define SPI_CLOCK_DIV4 0x00
+#define SPI_CLOCK_DIV16 0x01
+#define SPI_CLOCK_DIV64 0x02
+#define SPI_CLOCK_DIV128 0x03
+#define SPI_CLOCK_DIV2 0x04
+#define SPI_CLOCK_DIV8 0x05
+#define SPI_CLOCK_DIV32 0x06
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+/** Maximum number of devices on the simulated bus. */
+#define HOST_SPI_MAX_DEVICES 4
+/** CPU cycles between bytes for a call of SPI.transfer(uint8_t). */
+#define HOST_SPI_BYTE_OVERHEAD 6
+/** CPU cycles between bytes in a block transfer loop. */
+#define HOST_SPI_BLOCK_OVERHEAD 2
+/** Longest gap between two bytes of the same burst, for activeNanos. */
+#define HOST_SPI_BURST_GAP_NANOS 20000
+/** CPU cycles for a poll of an asynchronous transfer. */
+#define HOST_SPI_POLL_CYCLES 4
+/** Completion handler of an asynchronous transfer, called with zero. */
+typedef void (*HostSpiCallback)(uint8_t status);
+//------------------------------------------------------------------------------
+/**
+ * \class HostSpiDevice
+ * \brief A peripheral on the simulated SPI bus.
+ */
+class HostSpiDevice {
+ public:
+  /** Chip select went low. */
+  virtual void select() {}
+  /** Chip select went high. */
+  virtual void deselect() {}
+  /** Exchange one byte, MSB first, while selected. */
+  virtual uint8_t transfer(uint8_t data) = 0;
+};
+//------------------------------------------------------------------------------
+/**
+ * \class HostSpiBus
+ * \brief Shared SPI bus that routes bytes by chip select pin.
+ */
+class HostSpiBus {
+ public:
+  HostSpiBus();
+  /** Connect a device with its chip select pin. */
+  bool attach(uint8_t csPin, HostSpiDevice* dev);
+  /** Set the SCK divisor, rounded up to a power of two from 2 to 128. */
+  void setDivisor(uint8_t divisor);
+  /** \return current SCK divisor. */
+  uint8_t divisor() {return m_divisor;}
+  /** Set bit order, LSBFIRST or MSBFIRST. */
+  void setBitOrder(uint8_t order) {m_lsbFirst = order == LSBFIRST;}
+  /** Exchange one byte and charge its bus time plus overhead cycles.
+   *  Waits for an asynchronous transfer to end first. */
+  uint8_t transfer(uint8_t data, uint8_t overhead);
+  /** Start an asynchronous transfer. Bytes sent are 0XFF if tx is 0, bytes
+   *  received are dropped if rx is 0. done, if not 0, is called from an
+   *  interrupt at the end.
+   *  \return false if a transfer is running. */
+  bool startAsync(const uint8_t* tx, uint8_t* rx, size_t n,
+                  HostSpiCallback done);
+  /** \return true while an asynchronous transfer is running. */
+  bool asyncBusy() {return m_asyncLeft != 0;}
+  /** Clear the statistics. */
+  void resetStats();
+  /** Bytes clocked since the last resetStats(). */
+  uint32_t bytes;
+  /** Bytes clocked with no device selected. */
+  uint32_t idleBytes;
+  /** Bytes clocked with more than one device selected. */
+  uint32_t contention;
+  /** Nanoseconds SCK was running since the last resetStats(). */
+  uint64_t busyNanos;
+  /** Nanoseconds from the start to the end of each burst of bytes, where
+   *  a burst ends at a gap longer than HOST_SPI_BURST_GAP_NANOS.
+   *  busyNanos / activeNanos is the share of the SCK bandwidth used while
+   *  the bus is in use. */
+  uint64_t activeNanos;
+  /** Bytes clocked while each device was selected, in attach() order. */
+  uint32_t deviceBytes[HOST_SPI_MAX_DEVICES];
+  /** Bytes clocked by asynchronous transfers. */
+  uint32_t asyncBytes;
+  /** CPU transfers that had to wait for an asynchronous transfer. */
+  uint32_t collisions;
+
+ private:
+  static void asyncTask();
+  static void asyncIsr();
+  uint8_t exchange(uint8_t data);
+  uint64_t byteNanos() {return 8000000000ULL * m_divisor / F_CPU;}
+
+  uint8_t m_count;
+  uint8_t m_divisor;
+  bool m_lsbFirst;
+  uint8_t m_cs[HOST_SPI_MAX_DEVICES];
+  bool m_selected[HOST_SPI_MAX_DEVICES];
+  HostSpiDevice* m_dev[HOST_SPI_MAX_DEVICES];
+  const uint8_t* m_asyncTx;
+  uint8_t* m_asyncRx;
+  size_t m_asyncLeft;
+  uint64_t m_asyncNext;
+  HostSpiCallback m_asyncDone;
+  uint64_t m_lastEnd;
+};
+extern HostSpiBus HostSpi;
+//------------------------------------------------------------------------------
+/**
+ * \class SPISettings
+ * \brief Clock, bit order and mode for a transaction.
+ */
+class SPISettings {
+ public:
+  SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
+    init(clock, bitOrder, dataMode);
+  }
+  SPISettings() {
+    init(4000000, MSBFIRST, SPI_MODE0);
+  }
+
+ private:
+  void init(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {
+    divisor = 2;
+    while (divisor < 128 && F_CPU / divisor > clock) {
+      divisor <<= 1;
+    }
+    order = bitOrder;
+    mode = dataMode;
+  }
+  uint8_t divisor;
+  uint8_t order;
+  uint8_t mode;
+  friend class SPIClass;
+};
+//------------------------------------------------------------------------------
+/**
+ * \class SPIClass
+ * \brief Arduino SPI API on the simulated bus.
+ */
+class SPIClass {
+ public:
+  static void begin();
+  static void end();
+  static void usingInterrupt(uint8_t interruptNumber);
+  static void notUsingInterrupt(uint8_t interruptNumber);
+  static void beginTransaction(SPISettings settings);
+  static void endTransaction(void);
+  static uint8_t transfer(uint8_t data) {
+#ifdef SPI_PROFILE
+    SPIProfile::count(1);
+#endif  // SPI_PROFILE
+    return HostSpi.transfer(data, HOST_SPI_BYTE_OVERHEAD);
+  }
+  static uint16_t transfer16(uint16_t data) {
+    uint16_t r = transfer(data >> 8) << 8;
+    return r | transfer(data & 0XFF);
+  }
+  static void transfer(void* buf, size_t count) {
+    uint8_t* p = reinterpret_cast<uint8_t*>(buf);
+#ifdef SPI_PROFILE
+    SPIProfile::count(count);
+#endif  // SPI_PROFILE
+    for (size_t i = 0; i < count; i++) {
+      p[i] = HostSpi.transfer(p[i], HOST_SPI_BLOCK_OVERHEAD);
+    }
+  }
+  static void transfer(const void* txbuf, void* rxbuf, size_t count) {
+    const uint8_t* tx = reinterpret_cast<const uint8_t*>(txbuf);
+    uint8_t* rx = reinterpret_cast<uint8_t*>(rxbuf);
+#ifdef SPI_PROFILE
+    SPIProfile::count(count);
+#endif  // SPI_PROFILE
+    for (size_t i = 0; i < count; i++) {
+      uint8_t b = HostSpi.transfer(tx ? tx[i] : 0XFF, HOST_SPI_BLOCK_OVERHEAD);
+      if (rx) {
+        rx[i] = b;
+      }
+    }
+  }
+  static void setBitOrder(uint8_t bitOrder) {HostSpi.setBitOrder(bitOrder);}
+  static void setDataMode(uint8_t dataMode) {(void)dataMode;}
+  static void setClockDivider(uint8_t clockDiv);
+  static void attachInterrupt() {}
+  static void detachInterrupt() {}
+
+ private:
+  static uint8_t initialized;
+  static uint8_t interruptMode;  // 0=none, 1=mask, 2=global
+  static uint8_t interruptMask;  // which interrupts to mask
+  static uint8_t interruptSave;  // temp storage, to restore state
+};
+extern SPIClass SPI;
+#endif  // HostSPI_h
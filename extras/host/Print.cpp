@@ -0,0 +1,90 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ */
+#include <math.h>
+#include "Print.h"
+//------------------------------------------------------------------------------
+size_t Print::write(const uint8_t* buf, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buf++)) {
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+//------------------------------------------------------------------------------
+size_t Print::print(const __FlashStringHelper* str) {
+  return write(reinterpret_cast<const char*>(str));
+}
+//------------------------------------------------------------------------------
+size_t Print::print(long n, int base) {
+  if (base == 0) {
+    return write(static_cast<uint8_t>(n));
+  }
+  if (base == 10 && n < 0) {
+    size_t t = print('-');
+    return t + printNumber(-static_cast<unsigned long>(n), 10);
+  }
+  return printNumber(n, base);
+}
+//------------------------------------------------------------------------------
+size_t Print::print(unsigned long n, int base) {
+  if (base == 0) {
+    return write(static_cast<uint8_t>(n));
+  }
+  return printNumber(n, base);
+}
+//------------------------------------------------------------------------------
+size_t Print::print(double n, int digits) {
+  return printFloat(n, digits);
+}
+//------------------------------------------------------------------------------
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char* str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+//------------------------------------------------------------------------------
+size_t Print::printFloat(double number, uint8_t digits) {
+  size_t n = 0;
+  if (isnan(number)) {
+    return print("nan");
+  }
+  if (isinf(number)) {
+    return print("inf");
+  }
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i) {
+    rounding /= 10.0;
+  }
+  number += rounding;
+  unsigned long int_part = (unsigned long)number;
+  double remainder = number - (double)int_part;
+  n += print(int_part);
+  if (digits > 0) {
+    n += print('.');
+  }
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    int toPrint = static_cast<int>(remainder);
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
@@ -0,0 +1,79 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * Print class compatible with the Arduino core.
+ */
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print;
+class __FlashStringHelper;
+/**
+ * \class Printable
+ * \brief Object that knows how to print itself.
+ */
+class Printable {
+ public:
+  virtual size_t printTo(Print& p) const = 0;
+};
+/**
+ * \class Print
+ * \brief Formatted output to a byte sink.
+ */
+class Print {
+ public:
+  Print() : write_error(0) {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size);
+  size_t write(const char* str) {
+    return str ? write(reinterpret_cast<const uint8_t*>(str), strlen(str)) : 0;
+  }
+  size_t write(const char* buf, size_t size) {
+    return write(reinterpret_cast<const uint8_t*>(buf), size);
+  }
+  virtual void flush() {}
+  int getWriteError() {return write_error;}
+  void clearWriteError() {write_error = 0;}
+
+  size_t print(const __FlashStringHelper* str);
+  size_t print(const char* str) {return write(str);}
+  size_t print(char c) {return write(static_cast<uint8_t>(c));}
+  size_t print(unsigned char n, int base = DEC) {return print((unsigned long)n, base);}
+  size_t print(int n, int base = DEC) {return print((long)n, base);}
+  size_t print(unsigned int n, int base = DEC) {return print((unsigned long)n, base);}
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+  size_t print(const Printable& x) {return x.printTo(*this);}
+
+  size_t println() {return write("\r\n");}
+  template<typename T>
+  size_t println(T x) {
+    size_t n = print(x);
+    return n + println();
+  }
+  template<typename T>
+  size_t println(T x, int fmt) {
+    size_t n = print(x, fmt);
+    return n + println();
+  }
+
+ protected:
+  void setWriteError(int err = 1) {write_error = err;}
+
+ private:
+  size_t printNumber(unsigned long n, uint8_t base);
+  size_t printFloat(double number, uint8_t digits);
+  int write_error;
+};
+#endif  // Print_h
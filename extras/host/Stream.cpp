@@ -0,0 +1,109 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ */
+#include <Arduino.h>
+//------------------------------------------------------------------------------
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+  } while (millis() - start < m_timeout);
+  return -1;
+}
+//------------------------------------------------------------------------------
+int Stream::timedPeek() {
+  unsigned long start = millis();
+  do {
+    int c = peek();
+    if (c >= 0) {
+      return c;
+    }
+  } while (millis() - start < m_timeout);
+  return -1;
+}
+//------------------------------------------------------------------------------
+int Stream::peekNextDigit() {
+  for (;;) {
+    int c = timedPeek();
+    if (c < 0 || c == '-' || c == '.' || (c >= '0' && c <= '9')) {
+      return c;
+    }
+    read();
+  }
+}
+//------------------------------------------------------------------------------
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    *buffer++ = static_cast<char>(c);
+    count++;
+  }
+  return count;
+}
+//------------------------------------------------------------------------------
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t index = 0;
+  while (index < length) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) {
+      break;
+    }
+    *buffer++ = static_cast<char>(c);
+    index++;
+  }
+  return index;
+}
+//------------------------------------------------------------------------------
+long Stream::parseInt() {
+  bool isNegative = false;
+  long value = 0;
+  int c = peekNextDigit();
+  if (c < 0) {
+    return 0;
+  }
+  do {
+    if (c == '-') {
+      isNegative = true;
+    } else if (c >= '0' && c <= '9') {
+      value = value * 10 + c - '0';
+    }
+    read();
+    c = timedPeek();
+  } while (c >= '0' && c <= '9');
+  return isNegative ? -value : value;
+}
+//------------------------------------------------------------------------------
+float Stream::parseFloat() {
+  bool isNegative = false;
+  bool isFraction = false;
+  long value = 0;
+  float fraction = 1.0;
+  int c = peekNextDigit();
+  if (c < 0) {
+    return 0;
+  }
+  do {
+    if (c == '-') {
+      isNegative = true;
+    } else if (c == '.') {
+      isFraction = true;
+    } else if (c >= '0' && c <= '9') {
+      value = value * 10 + c - '0';
+      if (isFraction) {
+        fraction *= 0.1;
+      }
+    }
+    read();
+    c = timedPeek();
+  } while ((c >= '0' && c <= '9') || (c == '.' && !isFraction));
+  float f = isFraction ? value * fraction : value;
+  return isNegative ? -f : f;
+}
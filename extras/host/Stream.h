@@ -0,0 +1,38 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * Stream class compatible with the Arduino core.
+ */
+#ifndef Stream_h
+#define Stream_h
+
+#include "Print.h"
+/**
+ * \class Stream
+ * \brief Byte source with timed reads.
+ */
+class Stream : public Print {
+ public:
+  Stream() : m_timeout(1000) {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) {m_timeout = timeout;}
+  size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) {
+    return readBytes(reinterpret_cast<char*>(buffer), length);
+  }
+  size_t readBytesUntil(char terminator, char* buffer, size_t length);
+  long parseInt();
+  float parseFloat();
+
+ protected:
+  int timedRead();
+  int timedPeek();
+  int peekNextDigit();
+
+ private:
+  unsigned long m_timeout;
+};
+#endif  // Stream_h
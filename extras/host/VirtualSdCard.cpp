@@ -0,0 +1,390 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ */
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "VirtualSdCard.h"
+
+/** Waiting for a command. */
+#define MODE_CMD 0
+/** Sending data blocks for CMD17 or CMD18. */
+#define MODE_READ 1
+/** Waiting for a start block token of CMD24 or CMD25. */
+#define MODE_WRITE_TOKEN 2
+/** Receiving a data block. */
+#define MODE_WRITE_DATA 3
+//------------------------------------------------------------------------------
+static uint8_t crc7(const uint8_t* data, uint8_t n) {
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    uint8_t d = data[i];
+    for (uint8_t j = 0; j < 8; j++) {
+      crc <<= 1;
+      if ((d & 0x80) ^ (crc & 0x80)) {
+        crc ^= 0x09;
+      }
+      d <<= 1;
+    }
+  }
+  return (crc << 1) | 1;
+}
+//------------------------------------------------------------------------------
+static uint16_t crc16(const uint8_t* data, uint16_t n) {
+  uint16_t crc = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= data[i];
+    crc ^= (uint8_t)(crc & 0xff) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xff) << 5;
+  }
+  return crc;
+}
+//------------------------------------------------------------------------------
+VirtualSdCard::VirtualSdCard() : m_fd(-1), m_blocks(0) {
+  // Typical class 4 card timing.
+  accessMicros = 300;
+  nextBlockMicros = 40;
+  writeMicros = 1000;
+  nextWriteMicros = 200;
+  stopMicros = 500;
+  eraseMicros = 2000;
+  initPolls = 3;
+  minDivisor = 0;
+  powerCutBlocks = 0;
+  m_noise = 1;
+  resetStats();
+  m_mode = MODE_CMD;
+  m_idle = true;
+  m_app = false;
+  m_crc = false;
+  m_fresh = false;
+  m_multi = false;
+  m_polls = 0;
+  m_block = 0;
+  m_eraseStart = 0;
+  m_eraseEnd = 0;
+  m_readyAt = 0;
+  m_busyUntil = 0;
+  m_cmdLen = 0;
+  m_dataLen = 0;
+  m_outLen = 0;
+  m_outPos = 0;
+  m_outBlock = false;
+}
+//------------------------------------------------------------------------------
+VirtualSdCard::~VirtualSdCard() {
+  end();
+}
+//------------------------------------------------------------------------------
+bool VirtualSdCard::begin(const char* path, uint8_t csPin, bool readOnly) {
+  struct stat st;
+  end();
+  m_readOnly = readOnly;
+  m_fd = open(path, readOnly ? O_RDONLY : O_RDWR);
+  if (m_fd < 0 || fstat(m_fd, &st) || st.st_size < 1024L*512
+      || st.st_size % (1024L*512)) {
+    end();
+    return false;
+  }
+  m_blocks = st.st_size / 512;
+  return HostSpi.attach(csPin, this);
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::end() {
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+  m_fd = -1;
+  m_blocks = 0;
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::resetStats() {
+  commands = 0;
+  readCommands = 0;
+  writeCommands = 0;
+  blocksRead = 0;
+  blocksWritten = 0;
+  crcErrors = 0;
+  errors = 0;
+}
+//------------------------------------------------------------------------------
+bool VirtualSdCard::busy() {
+  return hostNanos() < m_busyUntil;
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::select() {
+  m_fresh = true;
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::deselect() {
+  m_cmdLen = 0;
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::queueR1(uint8_t flags) {
+  // One byte of Ncr before the response.
+  queue(0XFF);
+  queue(flags | (m_idle ? 0X01 : 0X00));
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::queueData(const uint8_t* src, uint16_t n) {
+  uint16_t crc = crc16(src, n);
+  queue(0XFE);
+  memcpy(m_out + m_outLen, src, n);
+  m_outLen += n;
+  queue(crc >> 8);
+  queue(crc & 0XFF);
+}
+//------------------------------------------------------------------------------
+uint8_t VirtualSdCard::transfer(uint8_t in) {
+  uint8_t out = 0XFF;
+  bool fresh = m_fresh;
+  m_fresh = false;
+  // A command aborts the data of a read, CMD12 ends CMD18 this way.
+  if (m_mode == MODE_READ && m_cmdLen == 0 && (in & 0XC0) == 0X40) {
+    m_mode = MODE_CMD;
+    m_outLen = m_outPos = 0;
+  }
+  if (m_outPos < m_outLen) {
+    out = m_out[m_outPos++];
+    if (m_outBlock && HostSpi.divisor() < minDivisor) {
+      // Bit errors at random, about one byte in a hundred.
+      m_noise = m_noise * 1103515245 + 12345;
+      if ((m_noise >> 16) % 100 == 0) {
+        out ^= 1 << (m_noise >> 28 & 7);
+      }
+    }
+    if (m_outPos == m_outLen && m_outBlock) {
+      m_outBlock = false;
+      blocksRead++;
+      if (m_multi && ++m_block < m_blocks) {
+        m_readyAt = hostNanos() + nextBlockMicros * 1000ULL;
+      } else {
+        m_mode = MODE_CMD;
+      }
+    }
+  } else if (busy()) {
+    out = 0X00;
+  } else if (m_mode == MODE_READ && !fresh && hostNanos() >= m_readyAt) {
+    // Data token is never the first byte after chip select goes low.
+    uint8_t buf[512];
+    m_outLen = m_outPos = 0;
+    if (pread(m_fd, buf, 512, 512ULL * m_block) != 512) {
+      memset(buf, 0, sizeof(buf));
+    }
+    queueData(buf, 512);
+    m_outBlock = true;
+    out = m_out[m_outPos++];
+  }
+  switch (m_mode) {
+    case MODE_WRITE_TOKEN:
+      if (in == (m_multi ? 0XFC : 0XFE)) {
+        m_mode = MODE_WRITE_DATA;
+        m_dataLen = 0;
+        return out;
+      } else if (m_multi && in == 0XFD) {
+        m_mode = MODE_CMD;
+        m_busyUntil = hostNanos() + stopMicros * 1000ULL;
+        return out;
+      }
+      break;
+
+    case MODE_WRITE_DATA:
+      m_data[m_dataLen++] = in;
+      if (m_dataLen == sizeof(m_data)) {
+        m_outLen = m_outPos = 0;
+        uint16_t crc = m_data[512] << 8 | m_data[513];
+        if (m_crc && crc != crc16(m_data, 512)) {
+          crcErrors++;
+          queue(0XEB);
+          m_mode = MODE_CMD;
+          return out;
+        }
+        if (m_readOnly || (!powerCut()
+            && pwrite(m_fd, m_data, 512, 512ULL * m_block) != 512)) {
+          errors++;
+          queue(0XED);
+          m_mode = MODE_CMD;
+          return out;
+        }
+        blocksWritten++;
+        queue(0XE5);
+        m_busyUntil = hostNanos()
+                      + (m_multi ? nextWriteMicros : writeMicros) * 1000ULL;
+        if (m_multi && ++m_block < m_blocks) {
+          m_mode = MODE_WRITE_TOKEN;
+        } else {
+          m_mode = MODE_CMD;
+        }
+      }
+      return out;
+  }
+  if (m_cmdLen == 0 && (in & 0XC0) != 0X40) {
+    return out;
+  }
+  m_cmd[m_cmdLen++] = in;
+  if (m_cmdLen == 6) {
+    m_cmdLen = 0;
+    command();
+  }
+  return out;
+}
+//------------------------------------------------------------------------------
+void VirtualSdCard::command() {
+  uint8_t cmd = m_cmd[0] & 0X3F;
+  uint32_t arg = (uint32_t)m_cmd[1] << 24 | (uint32_t)m_cmd[2] << 16
+                 | (uint32_t)m_cmd[3] << 8 | m_cmd[4];
+  bool app = m_app;
+  m_app = false;
+  m_outLen = m_outPos = 0;
+  commands++;
+  // CMD0 and CMD8 are always checked, others after CMD59 turns CRC on.
+  if ((m_crc || cmd == 0 || cmd == 8) && m_cmd[5] != crc7(m_cmd, 5)) {
+    crcErrors++;
+    queueR1(0X08);
+    return;
+  }
+  if (app) {
+    switch (cmd) {
+      case 41:
+        if (m_idle && ++m_polls >= initPolls) {
+          m_idle = false;
+        }
+        queueR1(0);
+        return;
+
+      case 23:
+        queueR1(0);
+        return;
+    }
+    errors++;
+    queueR1(0X04);
+    return;
+  }
+  switch (cmd) {
+    case 0:
+      m_mode = MODE_CMD;
+      m_idle = true;
+      m_crc = false;
+      m_polls = 0;
+      queueR1(0);
+      return;
+
+    case 8:
+      queueR1(0);
+      queue(0X00);
+      queue(0X00);
+      queue((arg >> 8) & 0X0F);
+      queue(arg & 0XFF);
+      return;
+
+    case 55:
+      m_app = true;
+      queueR1(0);
+      return;
+
+    case 58:
+      queueR1(0);
+      queue(m_idle ? 0X40 : 0XC0);
+      queue(0XFF);
+      queue(0X80);
+      queue(0X00);
+      return;
+
+    case 59:
+      m_crc = arg & 1;
+      queueR1(0);
+      return;
+
+    case 9: {
+      uint32_t c_size = m_blocks / 1024 - 1;
+      uint8_t csd[16] = {0X40, 0X0E, 0X00, 0X32, 0X5B, 0X59, 0X00,
+                         (uint8_t)((c_size >> 16) & 0X3F),
+                         (uint8_t)(c_size >> 8), (uint8_t)c_size,
+                         0X7F, 0X80, 0X0A, 0X40, 0X00, 0X00};
+      csd[15] = crc7(csd, 15);
+      queueR1(0);
+      queue(0XFF);
+      queueData(csd, 16);
+      return;
+    }
+    case 10: {
+      uint8_t cid[16] = {0X03, 'S', 'D', 'H', 'O', 'S', 'T', '0',
+                         0X10, 0X12, 0X34, 0X56, 0X78, 0X00, 0XF9, 0X00};
+      cid[15] = crc7(cid, 15);
+      queueR1(0);
+      queue(0XFF);
+      queueData(cid, 16);
+      return;
+    }
+    case 13:
+      queueR1(0);
+      queue(0X00);
+      return;
+
+    case 12:
+      m_mode = MODE_CMD;
+      queueR1(0);
+      return;
+
+    case 17:
+    case 18:
+    case 24:
+    case 25:
+      if (m_idle || m_fd < 0) {
+        errors++;
+        queueR1(0X04);
+        return;
+      }
+      if (arg >= m_blocks) {
+        errors++;
+        queueR1(0X40);
+        return;
+      }
+      m_block = arg;
+      m_multi = cmd == 18 || cmd == 25;
+      if (cmd < 24) {
+        readCommands++;
+        m_mode = MODE_READ;
+        m_readyAt = hostNanos() + accessMicros * 1000ULL;
+      } else {
+        writeCommands++;
+        m_mode = MODE_WRITE_TOKEN;
+      }
+      queueR1(0);
+      return;
+
+    case 32:
+      m_eraseStart = arg;
+      queueR1(0);
+      return;
+
+    case 33:
+      m_eraseEnd = arg;
+      queueR1(0);
+      return;
+
+    case 38: {
+      uint8_t zero[512];
+      memset(zero, 0, sizeof(zero));
+      if (m_eraseEnd < m_eraseStart || m_eraseEnd >= m_blocks) {
+        errors++;
+        queueR1(0X40);
+        return;
+      }
+      for (uint32_t b = m_eraseStart;
+           b <= m_eraseEnd && !m_readOnly && !powerCut(); b++) {
+        if (pwrite(m_fd, zero, 512, 512ULL * b) != 512) {
+          break;
+        }
+      }
+      queueR1(0);
+      m_busyUntil = hostNanos() + eraseMicros * 1000ULL;
+      return;
+    }
+  }
+  errors++;
+  queueR1(0X04);
+}
@@ -0,0 +1,104 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * SDHC card in SPI mode backed by a disk image. The image size must be
+ * a multiple of 512 KiB, the unit of C_SIZE in a version 2 CSD.
+ */
+#ifndef VirtualSdCard_h
+#define VirtualSdCard_h
+
+#include "HostSPI.h"
+/**
+ * \class VirtualSdCard
+ * \brief SPI mode SD protocol model with access and busy times.
+ */
+class VirtualSdCard : public HostSpiDevice {
+ public:
+  VirtualSdCard();
+  ~VirtualSdCard();
+  /** Open the disk image and attach the card to the SPI bus. */
+  bool begin(const char* path, uint8_t csPin = SS, bool readOnly = false);
+  /** Close the disk image. */
+  void end();
+  /** \return card size in 512 byte blocks. */
+  uint32_t blockCount() {return m_blocks;}
+  /** Clear the statistics. */
+  void resetStats();
+  /** \return true if the power has been cut. */
+  bool powerCut() {return powerCutBlocks && blocksWritten >= powerCutBlocks;}
+
+  /** Time from a read command to the first data token. */
+  uint32_t accessMicros;
+  /** Time between blocks of a multiple block read. */
+  uint32_t nextBlockMicros;
+  /** Busy time after a single block write. */
+  uint32_t writeMicros;
+  /** Busy time after each block of a multiple block write. */
+  uint32_t nextWriteMicros;
+  /** Busy time after the stop tran token. */
+  uint32_t stopMicros;
+  /** Busy time of an erase command. */
+  uint32_t eraseMicros;
+  /** Number of ACMD41 polls before the card leaves the idle state. */
+  uint8_t initPolls;
+  /** Blocks written before the power is cut, zero for never.  Writes and
+   *  erases after the cut are acknowledged and don't reach the image,
+   *  which stays as a card pulled at that moment. */
+  uint32_t powerCutBlocks;
+  /** Smallest SCK divisor the wiring of the card takes, zero for any.
+   *  Blocks read faster have about a byte in a hundred corrupted. */
+  uint8_t minDivisor;
+
+  /** Commands received. */
+  uint32_t commands;
+  /** CMD17 and CMD18 commands. */
+  uint32_t readCommands;
+  /** CMD24 and CMD25 commands. */
+  uint32_t writeCommands;
+  /** Data blocks sent to the host. */
+  uint32_t blocksRead;
+  /** Data blocks written to the image. */
+  uint32_t blocksWritten;
+  /** Commands and data blocks rejected for a bad CRC. */
+  uint32_t crcErrors;
+  /** Illegal commands and out of range addresses. */
+  uint32_t errors;
+
+  void select();
+  void deselect();
+  uint8_t transfer(uint8_t data);
+
+ private:
+  void command();
+  void queue(uint8_t b) {m_out[m_outLen++] = b;}
+  void queueR1(uint8_t flags);
+  void queueData(const uint8_t* src, uint16_t n);
+  bool busy();
+
+  int m_fd;
+  bool m_readOnly;
+  uint32_t m_blocks;
+  uint8_t m_mode;
+  bool m_idle;
+  bool m_app;
+  bool m_crc;
+  bool m_fresh;
+  bool m_multi;
+  uint8_t m_polls;
+  uint32_t m_block;
+  uint32_t m_eraseStart;
+  uint32_t m_eraseEnd;
+  uint64_t m_readyAt;
+  uint64_t m_busyUntil;
+  uint8_t m_cmd[6];
+  uint8_t m_cmdLen;
+  uint16_t m_dataLen;
+  uint8_t m_data[514];
+  uint8_t m_out[520];
+  uint16_t m_outLen;
+  uint16_t m_outPos;
+  bool m_outBlock;
+  uint32_t m_noise;
+};
+#endif  // VirtualSdCard_h
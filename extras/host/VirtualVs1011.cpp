@@ -0,0 +1,224 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ */
+#include "VirtualVs1011.h"
+
+#define SCI_MODE 0x00
+#define SCI_STATUS 0x01
+#define SCI_DECODE_TIME 0x04
+#define SCI_HDAT0 0x08
+#define SCI_HDAT1 0x09
+#define SM_RESET 0x0004
+/** HDAT1 of a WAV stream. */
+#define HDAT1_WAV 0x7665
+
+static const uint16_t mp3Bitrate[2][16] = {
+  {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0},
+  {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0}
+};
+//------------------------------------------------------------------------------
+uint8_t VsPort::transfer(uint8_t data) {
+  if (m_sdi) {
+    m_vs->sdi(data);
+    return 0XFF;
+  }
+  uint8_t out = 0XFF;
+  m_frame[m_pos] = data;
+  if (m_pos >= 2 && m_frame[0] == 0X03) {
+    if (m_pos == 2) {
+      m_vs->update();
+      uint16_t value = m_vs->reg(m_frame[1]);
+      m_frame[2] = value >> 8;
+      m_frame[3] = value & 0XFF;
+    }
+    out = m_frame[m_pos];
+  }
+  if (++m_pos == 4) {
+    m_pos = 0;
+    m_vs->sci(m_frame[0], m_frame[1], m_frame[2] << 8 | m_frame[3]);
+  }
+  return out;
+}
+//==============================================================================
+VirtualVs1011::VirtualVs1011() : m_capture(0) {
+  defaultByteRate = 16000;
+  m_sci.m_vs = this;
+  m_sci.m_sdi = false;
+  m_sci.m_pos = 0;
+  m_sdi.m_vs = this;
+  m_sdi.m_sdi = true;
+  m_sdi.m_pos = 0;
+  m_last = 0;
+  resetStats();
+  reset();
+  m_busyUntil = 0;
+}
+//------------------------------------------------------------------------------
+VirtualVs1011::~VirtualVs1011() {
+  if (m_capture) {
+    fclose(m_capture);
+  }
+}
+//------------------------------------------------------------------------------
+bool VirtualVs1011::begin(uint8_t xcs, uint8_t xdcs, uint8_t dreq) {
+  hostDrivePin(dreq, this);
+  return HostSpi.attach(xcs, &m_sci) && HostSpi.attach(xdcs, &m_sdi);
+}
+//------------------------------------------------------------------------------
+bool VirtualVs1011::capture(const char* path) {
+  if (m_capture) {
+    fclose(m_capture);
+  }
+  m_capture = fopen(path, "wb");
+  return m_capture != 0;
+}
+//------------------------------------------------------------------------------
+void VirtualVs1011::resetStats() {
+  underruns = 0;
+  overflows = 0;
+  sdiBytes = 0;
+  sciCommands = 0;
+}
+//------------------------------------------------------------------------------
+uint16_t VirtualVs1011::fill() {
+  update();
+  return m_fill;
+}
+//------------------------------------------------------------------------------
+int VirtualVs1011::pinLevel(uint8_t pin) {
+  (void)pin;
+  update();
+  return hostNanos() >= m_busyUntil && VS_FIFO_SIZE - m_fill >= VS_DREQ_SPACE;
+}
+//------------------------------------------------------------------------------
+void VirtualVs1011::reset() {
+  memset(m_reg, 0, sizeof(m_reg));
+  // SS_VER is 2 for VS1011.
+  m_reg[SCI_STATUS] = 0X0020;
+  m_fill = 0;
+  m_rate = defaultByteRate;
+  m_playing = false;
+  m_remainder = 0;
+  m_decoded = 0;
+  m_busyUntil = hostNanos() + VS_RESET_NANOS;
+  newStream();
+}
+//------------------------------------------------------------------------------
+// Next bytes start a new stream, at the rate of its own header.
+void VirtualVs1011::newStream() {
+  m_locked = false;
+  m_head = 0;
+  m_zeros = 0;
+  m_hdrLen = 0;
+  m_wavRemain = 0;
+  m_reg[SCI_HDAT1] = 0;
+}
+//------------------------------------------------------------------------------
+// Drain the stream buffer for the time elapsed since the last call.
+void VirtualVs1011::update() {
+  uint64_t now = hostNanos();
+  uint64_t dt = now - m_last;
+  m_last = now;
+  if (m_playing) {
+    uint64_t num = dt * m_rate + m_remainder;
+    uint64_t n = num / 1000000000ULL;
+    m_remainder = num % 1000000000ULL;
+    if (n >= m_fill) {
+      n = m_fill;
+      m_fill = 0;
+      m_playing = false;
+      m_remainder = 0;
+      underruns++;
+    } else {
+      m_fill -= n;
+    }
+    m_decoded += n;
+  }
+}
+//------------------------------------------------------------------------------
+void VirtualVs1011::sci(uint8_t op, uint8_t addr, uint16_t value) {
+  sciCommands++;
+  if (op != 0X02) {
+    return;
+  }
+  update();
+  addr &= 15;
+  if (addr == SCI_MODE && (value & SM_RESET)) {
+    reset();
+    return;
+  }
+  m_reg[addr] = value;
+  if (addr == SCI_DECODE_TIME) {
+    m_decoded = (uint64_t)value * m_rate;
+  }
+  m_busyUntil = hostNanos() + VS_SCI_WRITE_NANOS;
+}
+//------------------------------------------------------------------------------
+void VirtualVs1011::sdi(uint8_t b) {
+  update();
+  if (hostNanos() < m_busyUntil || m_fill >= VS_FIFO_SIZE) {
+    overflows++;
+    return;
+  }
+  m_fill++;
+  m_playing = true;
+  sdiBytes++;
+  if (m_capture) {
+    fputc(b, m_capture);
+  }
+  sniff(b);
+}
+//------------------------------------------------------------------------------
+// Pick the byte rate from a WAV header or an MPEG audio frame header.
+void VirtualVs1011::sniff(uint8_t b) {
+  if (m_wavRemain) {
+    // Samples, the stream ends with its data chunk.
+    if (--m_wavRemain == 0) {
+      newStream();
+    }
+    return;
+  }
+  if (b) {
+    m_zeros = 0;
+  } else if (++m_zeros >= VS_END_FILL) {
+    newStream();
+    return;
+  } else if (m_hdrLen == 0) {
+    return;
+  }
+  if (m_hdrLen < sizeof(m_hdr)) {
+    m_hdr[m_hdrLen++] = b;
+    if (m_hdrLen == 44 && m_reg[SCI_HDAT1] == HDAT1_WAV) {
+      m_wavRemain = (uint32_t)m_hdr[43] << 24 | (uint32_t)m_hdr[42] << 16
+                    | (uint32_t)m_hdr[41] << 8 | m_hdr[40];
+      return;
+    }
+  }
+  if (m_locked) {
+    return;
+  }
+  if (m_hdrLen == 32 && !memcmp(m_hdr, "RIFF", 4)
+      && !memcmp(m_hdr + 8, "WAVE", 4)) {
+    m_rate = (uint32_t)m_hdr[31] << 24 | (uint32_t)m_hdr[30] << 16
+             | (uint32_t)m_hdr[29] << 8 | m_hdr[28];
+    if (!m_rate) {
+      m_rate = defaultByteRate;
+    }
+    m_reg[SCI_HDAT1] = HDAT1_WAV;
+    m_locked = true;
+    return;
+  }
+  m_head = m_head << 8 | b;
+  // Sync word, layer III, valid bitrate and sample rate.
+  if ((m_head & 0XFFE00000) == 0XFFE00000 && ((m_head >> 17) & 3) == 1) {
+    uint8_t mpeg1 = (m_head >> 19) & 1;
+    uint16_t kbps = mp3Bitrate[mpeg1][(m_head >> 12) & 15];
+    if (kbps && ((m_head >> 10) & 3) != 3) {
+      m_rate = kbps * 125UL;
+      m_reg[SCI_HDAT1] = m_head >> 16;
+      m_reg[SCI_HDAT0] = m_head & 0XFFFF;
+      m_locked = true;
+    }
+  }
+}
@@ -0,0 +1,106 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * VS1011 model: SCI registers, a 2048 byte SDI stream buffer drained at
+ * the byte rate of the stream, and DREQ. The byte rate comes from the
+ * header of a WAV stream or from the first MPEG audio frame header,
+ * anything else is drained at defaultByteRate. A new stream starts after
+ * a reset, after the data chunk of a WAV or after an end fill of 2048
+ * zeros.
+ */
+#ifndef VirtualVs1011_h
+#define VirtualVs1011_h
+
+#include <stdio.h>
+#include "HostSPI.h"
+
+/** Size of the SDI stream buffer. */
+#define VS_FIFO_SIZE 2048
+/** DREQ is high when this much space is free. */
+#define VS_DREQ_SPACE 32
+/** DREQ low time after an SCI write. */
+#define VS_SCI_WRITE_NANOS 5000
+/** DREQ low time after a software reset. */
+#define VS_RESET_NANOS 2000000
+/** Zeros after a stream that end it, the next bytes start a new one. */
+#define VS_END_FILL 2048
+
+class VirtualVs1011;
+/**
+ * \class VsPort
+ * \brief One of the two SPI interfaces of the codec.
+ */
+class VsPort : public HostSpiDevice {
+ public:
+  void select() {m_pos = 0;}
+  uint8_t transfer(uint8_t data);
+
+ private:
+  friend class VirtualVs1011;
+  VirtualVs1011* m_vs;
+  bool m_sdi;
+  uint8_t m_pos;
+  uint8_t m_frame[4];
+};
+/**
+ * \class VirtualVs1011
+ * \brief Codec model attached to XCS, XDCS and DREQ.
+ */
+class VirtualVs1011 : public HostPinDriver {
+ public:
+  VirtualVs1011();
+  ~VirtualVs1011();
+  /** Attach the codec to the bus and drive DREQ. */
+  bool begin(uint8_t xcs, uint8_t xdcs, uint8_t dreq);
+  /** Copy every SDI byte to a file. */
+  bool capture(const char* path);
+  /** Clear the statistics. */
+  void resetStats();
+  /** \return value of an SCI register. */
+  uint16_t reg(uint8_t addr) {return m_reg[addr & 15];}
+  /** \return bytes waiting in the stream buffer. */
+  uint16_t fill();
+  /** \return byte rate of the current stream. */
+  uint32_t byteRate() {return m_rate;}
+  int pinLevel(uint8_t pin);
+
+  /** Byte rate of streams without a recognized header. */
+  uint32_t defaultByteRate;
+  /** Times the stream buffer ran empty while a stream was playing. */
+  uint32_t underruns;
+  /** SDI bytes sent while the stream buffer was full. */
+  uint32_t overflows;
+  /** SDI bytes received. */
+  uint32_t sdiBytes;
+  /** SCI reads and writes. */
+  uint32_t sciCommands;
+
+ private:
+  friend class VsPort;
+  void update();
+  void reset();
+  void newStream();
+  void sci(uint8_t op, uint8_t addr, uint16_t value);
+  void sdi(uint8_t b);
+  void sniff(uint8_t b);
+
+  VsPort m_sci;
+  VsPort m_sdi;
+  FILE* m_capture;
+  uint16_t m_reg[16];
+  uint32_t m_fill;
+  uint32_t m_rate;
+  bool m_locked;
+  bool m_playing;
+  uint64_t m_last;
+  uint64_t m_remainder;
+  uint64_t m_decoded;
+  uint64_t m_busyUntil;
+  uint32_t m_head;
+  uint16_t m_zeros;
+  uint32_t m_wavRemain;
+  uint8_t m_hdr[44];
+  uint8_t m_hdrLen;
+};
+#endif  // VirtualVs1011_h
@@ -0,0 +1,16 @@
+/*
+ * Host (Linux) core for Tune and SdFat
+ * Copyleft Snootlab 2015
+ *
+ * EEPROM of an ATmega328P, the avr-libc byte functions. It is erased at
+ * each run unless main() is given a file to keep it in.
+ */
+#ifndef avr_eeprom_h
+#define avr_eeprom_h
+
+#include <Arduino.h>
+
+uint8_t eeprom_read_byte(const uint8_t* addr);
+void eeprom_write_byte(uint8_t* addr, uint8_t value);
+void eeprom_update_byte(uint8_t* addr, uint8_t value);
+#endif  // avr_eeprom_h
@@ -0,0 +1,140 @@
+/*
+ * Shuffle test for Tune on Linux
+ * Copyleft Snootlab 2015
+ *
+ * Checks that the shuffle order is a permutation of the tracks for
+ * tracklists of 1 to 65535 tracks, then that playNext() plays every
+ * track exactly once per cycle, that a cycle doesn't start with the
+ * track that ended the previous one, and that a track picked by play()
+ * starts a new cycle. Creates a SHUFFLE folder of empty tracks and
+ * plays from it, run it on a copy of the image.
+ *
+ * Built without Tune.cpp on the command line : it includes it, to reach
+ * the shuffle state and the tracklist. Prints "shuffle ok" and exits
+ * with 0 if every check passed.
+ */
+
+#define private public
+#include "Tune.cpp"
+#undef private
+
+Tune player;
+
+// Tracks of the SHUFFLE folder, and cycles played through
+const unsigned int tracks = 20;
+const int cycles = 4;
+
+// One bit per track
+byte seen[8192];
+unsigned int errors = 0;
+
+void fail(const char* what, unsigned long value)
+{
+  Serial.print("FAIL ");
+  Serial.print(what);
+  Serial.print(' ');
+  Serial.println(value);
+  errors++;
+}
+
+bool markSeen(unsigned int n)
+{
+  byte bit = 1 << (n & 7);
+  if (seen[n >> 3] & bit) return false;
+  seen[n >> 3] |= bit;
+  return true;
+}
+
+// Every position gives a different track, and shufflePosition() undoes it
+void checkPermutation(unsigned int n)
+{
+  nb_track = n;
+  for (int key = 0; key < 4; key++)
+  {
+    player.newShuffle();
+    memset(seen, 0, sizeof(seen));
+    for (unsigned int pos = 0; pos < n; pos++)
+    {
+      unsigned int t = player.shuffleTrack(pos);
+      if (t >= n || !markSeen(t)) fail("permutation of", n);
+      else if (player.shufflePosition(t) != pos) fail("inverse of", n);
+    }
+  }
+}
+
+// The next tracks played must be each track once
+void checkCycle(const char* what)
+{
+  unsigned int last = player.currentTrack;
+  memset(seen, 0, sizeof(seen));
+  for (unsigned int i = 0; i < nb_track; i++)
+  {
+    player.playNext();
+    unsigned int t = player.currentTrack;
+    if (t >= nb_track || !markSeen(t)) fail(what, t);
+    if (t == last) fail("same track twice in a row", t);
+    last = t;
+  }
+}
+
+void setup()
+{
+  Serial.begin(9600);
+
+  const unsigned int sizes[] = {1, 2, 3, 7, 8, 9, 100, 255, 256, 257, 1000, 32768, 32769, 65535};
+  for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    checkPermutation(sizes[i]);
+  }
+
+  if (!player.begin()) exit(1);
+
+  // Empty tracks, playNext() only needs them to open
+  if (!sd.exists("SHUFFLE") && !sd.mkdir("SHUFFLE")) sd.errorHalt("mkdir");
+  char name[] = "SHUFFLE/TRACK00.MP3";
+  for (unsigned int i = 0; i < tracks; i++)
+  {
+    sprintf(name + 13, "%02u.MP3", i);
+    SdFile file;
+    if (!file.open(name, O_CREAT | O_WRITE)) sd.errorHalt("create");
+    file.close();
+  }
+  // List them instead of the tracks of the root
+  if (!sd.chdir("SHUFFLE")) sd.errorHalt("chdir");
+  for (unsigned int i = 0; i < nb_track; i++)
+  {
+    free(player.tracklist[i]);
+  }
+  free(player.tracklist);
+  player.listFiles();
+  player.currentTrack = nb_track;
+  if (player.getNbTracks() != tracks) fail("tracks found", player.getNbTracks());
+
+  player.setShuffle(true);
+  for (int i = 0; i < cycles; i++)
+  {
+    checkCycle("track played twice in a cycle");
+  }
+
+  // A track picked in the middle of a cycle starts a new one
+  player.playNext();
+  player.playNext();
+  player.stopTrack();
+  player.play(player.tracklist[3]);
+  if (player.currentTrack != 3) fail("play() track", player.currentTrack);
+  memset(seen, 0, sizeof(seen));
+  markSeen(3);
+  for (unsigned int i = 1; i < nb_track; i++)
+  {
+    player.playNext();
+    if (!markSeen(player.currentTrack)) fail("track played twice after play()", player.currentTrack);
+  }
+  player.stopTrack();
+
+  Serial.println(errors ? "shuffle failed" : "shuffle ok");
+  exit(errors ? 1 : 0);
+}
+
+void loop()
+{
+}